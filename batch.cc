@@ -0,0 +1,338 @@
+// Game of Othello -- streaming batch solver
+// Universidad Simon Bolivar, 2012.
+
+#include "batch.h"
+#include "protocol.h"
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+using namespace std;
+
+namespace {
+
+const size_t CHUNK = 1024;      // positions per chunk
+const int INPUT_RECORD = 12;
+const int OUTPUT_RECORD = 16;
+const uint64_t MAX_TERNARY = 1853020188851841ULL;  // 3^32
+const char *status_names[] = { "ok", "aborted", "bad" };
+
+// position index of each square, in reading order
+struct square_table_t {
+    int pos[DIM];
+    square_table_t() {
+        int next = 4;
+        for ( int k = 0; k < DIM; ++k ) {
+            int i = k / N, j = k % N;
+            bool centre = (i == 2 || i == 3) && (j == 2 || j == 3);
+            pos[k] = centre ? ((i - 2) << 1) + (j - 2) : next++;
+        }
+    }
+} squares;
+
+struct item_t {
+    state_t state;
+    int color = 1;
+    int status = BATCH_OK;
+    int value = 0;
+    int best_move = -1;
+    unsigned long long generated = 0;
+};
+
+struct chunk_t {
+    unsigned long long seq = 0;
+    unsigned long long first = 0;   // index of the first item
+    vector<item_t> items;
+};
+
+// Lossy, fixed-size cache of solved positions: each position has one
+// slot, and a newer position simply overwrites it.
+class result_cache_t {
+  public:
+    explicit result_cache_t(size_t entries) : entries_(max<size_t>(1, entries)) { }
+
+    bool find(item_t &item, bool need_best) {
+        uint64_t k = key(item);
+        size_t i = slot(k);
+        entry_t &e = entries_[i];
+        lock_guard<mutex> lock(locks_[i % NLOCKS]);
+        if ( !e.used || e.key != k || (need_best && !e.has_best) )
+            return false;
+        item.value = e.value;
+        item.best_move = e.best_move;
+        return true;
+    }
+
+    void insert(const item_t &item, bool has_best) {
+        uint64_t k = key(item);
+        size_t i = slot(k);
+        entry_t &e = entries_[i];
+        lock_guard<mutex> lock(locks_[i % NLOCKS]);
+        e.key = k;
+        e.value = item.value;
+        e.best_move = item.best_move;
+        e.has_best = has_best;
+        e.used = true;
+    }
+
+  private:
+    static const size_t NLOCKS = 64;
+    struct entry_t {
+        uint64_t key = 0;   // packed position, side to move in the top bit
+        signed char value = 0, best_move = -1;
+        bool has_best = false, used = false;
+    };
+    vector<entry_t> entries_;
+    mutex locks_[NLOCKS];
+
+    static uint64_t key(const item_t &item) {
+        return item.state.pack() | uint64_t(item.color == 1) << 63;
+    }
+
+    size_t slot(uint64_t k) const {
+        k ^= k >> 33;
+        k *= 0xff51afd7ed558ccdULL;
+        k ^= k >> 33;
+        return k % entries_.size();
+    }
+};
+
+struct pipeline_t {
+    mutex m;
+    condition_variable todo_ready, done_ready, space_ready;
+    deque<unique_ptr<chunk_t>> todo;
+    map<unsigned long long, unique_ptr<chunk_t>> done;
+    size_t in_flight = 0;
+    size_t max_in_flight = 4;
+    unsigned long long total = 0;
+    bool eof = false;
+    bool failed = false;    // a worker threw: everybody stops
+};
+
+// Reads up to CHUNK positions; returns false at the end of the input.
+bool read_chunk(istream &is, const batch_options_t &options, chunk_t &chunk) {
+    if ( options.binary_input ) {
+        static thread_local vector<uint8_t> buf(CHUNK * INPUT_RECORD);
+        is.read(reinterpret_cast<char*>(&buf[0]), buf.size());
+        size_t n = is.gcount() / INPUT_RECORD;
+        if ( is.gcount() % INPUT_RECORD != 0 )
+            cerr << "warning: ignoring a truncated record at the end of the input" << endl;
+        for ( size_t i = 0; i < n; ++i ) {
+            const uint8_t *r = &buf[i * INPUT_RECORD];
+            item_t item;
+            uint64_t key = get<uint64_t>(r, 0);
+            item.state = state_t::unpack(key);
+            item.color = get<int8_t>(r, 8);
+            // keys past 4 bits of t_ and 32 base-3 digits are not positions
+            if ( (item.color != 1 && item.color != -1) || key >> 4 >= MAX_TERNARY ) item.status = BATCH_BAD_INPUT;
+            chunk.items.push_back(item);
+        }
+    } else {
+        string line;
+        while ( chunk.items.size() < CHUNK && getline(is, line) ) {
+            if ( line.empty() || line[0] == '#' || line == "\r" ) continue;
+            item_t item;
+            if ( !parse_position(line, item.state, item.color) ) item.status = BATCH_BAD_INPUT;
+            chunk.items.push_back(item);
+        }
+    }
+    return !chunk.items.empty();
+}
+
+void write_chunk(ostream &os, const batch_options_t &options, const chunk_t &chunk) {
+    for ( size_t i = 0; i < chunk.items.size(); ++i ) {
+        const item_t &item = chunk.items[i];
+        if ( options.binary_output ) {
+            uint8_t r[OUTPUT_RECORD] = { };
+            put<uint64_t>(r, 0, chunk.first + i);
+            put<int8_t>(r, 8, item.value);
+            put<int8_t>(r, 9, item.best_move);
+            put<uint8_t>(r, 10, item.status);
+            put<uint32_t>(r, 12, item.generated < UINT32_MAX ? item.generated : UINT32_MAX);
+            os.write(reinterpret_cast<char*>(r), sizeof(r));
+        } else if ( item.status == BATCH_BAD_INPUT ) {
+            os << chunk.first + i << ",,," << status_names[item.status] << ",0\n";
+        } else {
+            os << chunk.first + i << "," << item.value << "," << item.best_move << ","
+               << status_names[item.status] << "," << item.generated << "\n";
+        }
+    }
+}
+
+void solve_chunks(const batch_options_t &options, int index, pipeline_t &p, result_cache_t &cache) {
+    try {
+        // spill files are mapped shared and not locked: one pair per thread
+        searcher_options_t searcher_options = options.searcher;
+        if ( options.threads > 1 && !searcher_options.spill_path.empty() )
+            searcher_options.spill_path += "." + to_string(index);
+        Searcher searcher(searcher_options);
+        search_limits_t limits = options.limits;
+        limits.want_pv = options.best_move;
+        if ( limits.use_tt || options.algorithm == MTDF ) searcher.reserve();
+
+        while ( true ) {
+            unique_ptr<chunk_t> chunk;
+            {
+                unique_lock<mutex> lock(p.m);
+                p.todo_ready.wait(lock, [&] { return !p.todo.empty() || p.eof || p.failed; });
+                if ( p.todo.empty() || p.failed ) return;
+                chunk = move(p.todo.front());
+                p.todo.pop_front();
+            }
+
+            for ( auto &item : chunk->items ) {
+                if ( item.status == BATCH_BAD_INPUT || cache.find(item, options.best_move) ) continue;
+                search_result_t r = searcher.solve(item.state, item.color, options.algorithm, limits);
+                item.status = r.complete ? BATCH_OK : BATCH_ABORTED;
+                item.value = item.color * r.value;
+                item.best_move = r.best_move;
+                item.generated = r.stats.generated;
+                // the PV search may run out of budget after the value is known
+                if ( r.complete ) cache.insert(item, options.best_move && r.pv_complete);
+            }
+
+            {
+                lock_guard<mutex> lock(p.m);
+                p.done[chunk->seq] = move(chunk);
+            }
+            p.done_ready.notify_one();
+        }
+    } catch ( const exception &e ) {
+        // e.g. the spill file cannot be created or out of memory
+        cerr << "error: " << e.what() << endl;
+        {
+            lock_guard<mutex> lock(p.m);
+            p.failed = true;
+        }
+        p.todo_ready.notify_all();
+        p.done_ready.notify_all();
+        p.space_ready.notify_all();
+    }
+}
+
+void write_chunks(const batch_options_t &options, pipeline_t &p, ostream &os) {
+    for ( unsigned long long next = 0; ; ++next ) {
+        unique_ptr<chunk_t> chunk;
+        {
+            unique_lock<mutex> lock(p.m);
+            p.done_ready.wait(lock, [&] { return p.done.count(next) || (p.eof && next == p.total) || p.failed; });
+            if ( !p.done.count(next) || p.failed ) return;
+            chunk = move(p.done[next]);
+            p.done.erase(next);
+            --p.in_flight;
+        }
+        p.space_ready.notify_one();
+        write_chunk(os, options, *chunk);
+    }
+}
+
+} // end of namespace
+
+bool parse_position(const string &line, state_t &state, int &color) {
+    // nothing may follow the side to move but the \r of a CRLF file
+    size_t size = line.size() == DIM + 3 && line[DIM + 2] == '\r' ? DIM + 2 : line.size();
+    if ( size != DIM + 2 || line[DIM] != ' ' ) return false;
+    unsigned char t = 0;
+    unsigned free = 0, pos = 0;
+    for ( int k = 0; k < DIM; ++k ) {
+        int p = squares.pos[k];
+        char c = line[k];
+        if ( c == '.' && p >= 4 ) continue;
+        if ( c != 'B' && c != 'W' ) return false;
+        if ( p < 4 ) {
+            if ( c == 'B' ) t |= 1 << p;
+        } else {
+            free |= 1u << (p - 4);
+            if ( c == 'B' ) pos |= 1u << (p - 4);
+        }
+    }
+    char side = line[DIM + 1];
+    if ( side != 'B' && side != 'W' ) return false;
+    state = state_t(t, free, pos);
+    color = side == 'B' ? 1 : -1;
+    return true;
+}
+
+string format_position(const state_t &state, int color) {
+    string line(DIM + 2, ' ');
+    for ( int k = 0; k < DIM; ++k ) {
+        int p = squares.pos[k];
+        line[k] = state.is_free(p) ? '.' : (state.is_black(p) ? 'B' : 'W');
+    }
+    line[DIM + 1] = color == 1 ? 'B' : 'W';
+    return line;
+}
+
+int run_batch(const batch_options_t &options) {
+    ifstream in_file;
+    ofstream out_file;
+    istream *in = &cin;
+    ostream *out = &cout;
+    if ( options.input != "-" ) {
+        in_file.open(options.input.c_str(), ios::binary);
+        if ( !in_file ) {
+            cerr << "error: cannot open " << options.input << endl;
+            return 1;
+        }
+        in = &in_file;
+    }
+    if ( options.output != "-" ) {
+        out_file.open(options.output.c_str(), ios::binary);
+        if ( !out_file ) {
+            cerr << "error: cannot create " << options.output << endl;
+            return 1;
+        }
+        out = &out_file;
+    }
+    if ( !options.binary_output ) *out << "index,value,best_move,status,generated\n";
+
+    int nthreads = max(1, options.threads);
+    pipeline_t p;
+    p.max_in_flight = 2 * nthreads + 2;
+    result_cache_t cache(options.cache_entries);
+
+    vector<thread> threads;
+    for ( int i = 0; i < nthreads; ++i )
+        threads.emplace_back(solve_chunks, cref(options), i, ref(p), ref(cache));
+    thread writer(write_chunks, cref(options), ref(p), ref(*out));
+
+    unsigned long long index = 0;
+    while ( true ) {
+        unique_ptr<chunk_t> chunk(new chunk_t);
+        if ( !read_chunk(*in, options, *chunk) ) break;
+        chunk->first = index;
+        index += chunk->items.size();
+        {
+            unique_lock<mutex> lock(p.m);
+            p.space_ready.wait(lock, [&] { return p.in_flight < p.max_in_flight || p.failed; });
+            if ( p.failed ) break;
+            chunk->seq = p.total++;
+            ++p.in_flight;
+            p.todo.push_back(move(chunk));
+        }
+        p.todo_ready.notify_one();
+    }
+    {
+        lock_guard<mutex> lock(p.m);
+        p.eof = true;
+    }
+    p.todo_ready.notify_all();
+    p.done_ready.notify_all();
+
+    for ( auto &t : threads ) t.join();
+    writer.join();
+    if ( p.failed ) return 1;
+    out->flush();
+    if ( !*out ) {
+        cerr << "error: cannot write the results" << endl;
+        return 1;
+    }
+    return 0;
+}
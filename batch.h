@@ -0,0 +1,62 @@
+// Game of Othello -- streaming batch solver
+// Universidad Simon Bolivar, 2012.
+//
+// Solves an unbounded stream of positions read from a file or stdin.
+//
+// Text input has one position per line: the 36 squares in reading order
+// ('B', 'W' or '.'), a space and the side to move ('B' or 'W'), and
+// nothing else but an optional '\r'. Blank lines and lines starting with
+// '#' are skipped. Binary input is a
+// sequence of 12-byte records: uint64 packed position (state_t::pack),
+// int8 color (1 black, -1 white) and three reserved bytes, in host byte
+// order.
+//
+// Results come out in input order. CSV has the header
+// "index,value,best_move,status,generated"; binary output is a sequence
+// of 16-byte records: uint64 index, int8 value, int8 best move, uint8
+// status, one reserved byte and uint32 #generated (saturated). Values are
+// from black's point of view, as main prints them; the best move is -1
+// unless asked for.
+//
+// Parsing, solving (one Searcher per thread) and writing run in a
+// pipeline of fixed-size chunks with a bounded number of chunks in
+// flight, so memory use does not depend on the size of the input.
+// Repeated positions are answered from a fixed-size cache of results.
+//
+// The spill file of a Searcher is not shared safely between threads, so
+// with more than one thread each one gets its own pair of spill files:
+// thread i uses spill_path.<i>.0 and spill_path.<i>.1, each spill_bytes
+// large (they are sparse).
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "othello_cut.h"
+#include "searcher.h"
+
+#include <string>
+
+struct batch_options_t {
+    std::string input = "-";       // "-" is stdin
+    std::string output = "-";      // "-" is stdout
+    bool binary_input = false;
+    bool binary_output = false;
+    int threads = 1;
+    int algorithm = ALPHABETA;
+    search_limits_t limits;        // per position
+    bool best_move = false;
+    searcher_options_t searcher;   // of each thread (see above for spill_path)
+    size_t cache_entries = size_t(1) << 20;
+};
+
+enum { BATCH_OK, BATCH_ABORTED, BATCH_BAD_INPUT };
+
+// Parses a text line; returns false if it is not a position.
+bool parse_position(const std::string &line, state_t &state, int &color);
+// The text line for a position, without the newline.
+std::string format_position(const state_t &state, int color);
+
+// Returns 0 on success, 1 on I/O errors.
+int run_batch(const batch_options_t &options);
+
+#endif
@@ -0,0 +1,339 @@
+// Game of Othello -- per-node benchmark of the search kernels
+// Universidad Simon Bolivar, 2012.
+//
+// Runs every algorithm over the last positions of the PV and reports
+// #generated/second of:
+//   - the reference kernels below, which keep the side to move, the TT
+//     flag and the comparison of test as runtime arguments (int color,
+//     bool use_tt, bool cond), like main.cc did before the searcher;
+//   - the searcher's kernels, specialised on all of them;
+// both with the scan backend, and their ratio, i.e. what specialisation
+// alone buys. A last column has the searcher with the vector backend.
+// SSS* keeps a runtime colour in the searcher too, so it has no
+// reference. Values and #generated must match everywhere.
+//
+// Usage: bench [#positions]   (default: 14, i.e. PV steps 34 down to 21)
+
+#include <iostream>
+#include <iomanip>
+#include "othello_cut.h"
+#include "movegen.h"
+#include "searcher.h"
+#include "utils.h"
+
+using namespace std;
+
+// The searcher's kernels with runtime flags instead of template
+// parameters; only the move generator is still one, so that both sides
+// of the comparison use the same backend.
+template<class MG> class reference_t {
+  public:
+    unsigned long long expanded = 0;
+    unsigned long long generated = 0;
+
+    explicit reference_t(size_t tt_bytes) {
+        for ( int c = 0; c < 2; ++c ) {
+            tt[c].configure(tt_bytes);
+            tt[c].reserve();
+        }
+    }
+
+    // value for the side to move, like the searcher's run<COLOR, MG>
+    int solve(const state_t &state, int color, int algorithm, bool use_tt, int f) {
+        tt[0].clear();
+        tt[1].clear();
+        expanded = generated = 0;
+        if ( algorithm == MINMAX ) return negamax(state, color);
+        if ( algorithm == ALPHABETA ) return negamax(state, use_tt ? state.pack() : 0, -INF, INF, color, use_tt);
+        if ( algorithm == SCOUT ) return color * scout(state, color);
+        if ( algorithm == NEGASCOUT ) return negascout(state, -INF, INF, color);
+        return mtdf(state, color, f);
+    }
+
+  private:
+    ttable_t tt[2];
+
+    int negamax(const state_t &state, int color) {
+        ++generated;
+        if (state.terminal())
+            return color * state.value();
+
+        int score = -INF;
+        int moves[DIM];
+        int nmoves = color == 1 ? MG::template generate<true>(state, moves) : MG::template generate<false>(state, moves);
+        for (int i = 0; i < nmoves; ++i) {
+            score = std::max(
+                        score,
+                        -negamax(state.move(color == 1, moves[i]), -color)
+                    );
+        }
+        if (nmoves == 0)
+            score = -negamax(state, -color);
+
+        ++expanded;
+        return score;
+    }
+
+    int negamax(const state_t &state, uint64_t key, int alpha, int beta, int color, bool use_tt) {
+        unsigned long long first_generated = generated;
+        ++generated;
+        int original_alpha = alpha;
+
+        ttable_t::slot_t slot = { nullptr, 0 };  // only read when use_tt
+        stored_info_t tup;
+        if (use_tt && tt[color == 1].probe(state, key, slot, tup)) {
+            if (tup.type_ == EXACT) {
+                return tup.value_;
+            }
+            else if (tup.type_ == UPPER) {
+                beta = std::min(beta, tup.value_);
+            }
+            else if (tup.type_ == LOWER) {
+                alpha = std::max(alpha, tup.value_);
+            }
+
+            if (alpha >= beta)
+                return tup.value_;
+        }
+
+        if (state.terminal())
+            return color * state.value();
+
+        int score = -INF;
+        int moves[DIM];
+        int nmoves = color == 1 ? MG::template generate<true>(state, moves) : MG::template generate<false>(state, moves);
+        state_t childs[DIM];
+        uint64_t keys[DIM];
+        if (use_tt) {
+            for (int i = 0; i < nmoves; ++i) {
+                childs[i] = state.move(color == 1, moves[i]);
+                keys[i] = childs[i].pack();
+                tt[color != 1].prefetch(keys[i]);
+            }
+            if (tt[color != 1].probes_spill(state.empties() - 1)) {
+                for (int i = 0; i < nmoves; ++i)
+                    tt[color != 1].prefetch_spill(keys[i]);
+            }
+        }
+        for (int i = 0; i < nmoves; ++i) {
+            score = std::max(
+                        score,
+                        -negamax(use_tt ? childs[i] : state.move(color == 1, moves[i]), use_tt ? keys[i] : 0, -beta, -alpha, -color, use_tt)
+                    );
+            alpha = std::max(alpha, score);
+            if (alpha >= beta)
+                break;
+        }
+        if (nmoves == 0)
+            score = -negamax(state, key, -beta, -alpha, -color, use_tt);
+
+        if (use_tt) {
+            tup = {score, EXACT};
+            if (score <= original_alpha)
+                tup.type_ = UPPER;
+            else if (score >= beta)
+                tup.type_ = LOWER;
+            tt[color == 1].store(slot, tup, generated - first_generated);
+        }
+
+        ++expanded;
+        return score;
+    }
+
+    // cond : 0 es > ; 1 es >=
+    bool test(const state_t &state, int color, int score, bool cond) {
+        ++generated;
+        if (state.terminal())
+            return (cond ? state.value() >= score : state.value() > score);
+
+        ++expanded;
+        int moves[DIM];
+        int nmoves = color == 1 ? MG::template generate<true>(state, moves) : MG::template generate<false>(state, moves);
+        for (int i = 0; i < nmoves; ++i) {
+            auto child = state.move(color == 1, moves[i]);
+            if (color == 1 && test(child, -color, score, cond))
+                return true;
+            if (color == -1 && !test(child, -color, score, cond))
+                return false;
+        }
+
+        if (nmoves == 0) {
+            if (color == 1 && test(state, -color, score, cond))
+                return true;
+            if (color == -1 && !test(state, -color, score, cond))
+                return false;
+        }
+
+        return color == -1;
+    }
+
+    int scout(const state_t &state, int color) {
+        ++generated;
+        if (state.terminal())
+            return state.value();
+
+        int score = 0;
+        int moves[DIM];
+        int nmoves = color == 1 ? MG::template generate<true>(state, moves) : MG::template generate<false>(state, moves);
+        for (int i = 0; i < nmoves; ++i) {
+            auto child = state.move(color == 1, moves[i]);
+            if (i == 0)
+                score = scout(child, -color);
+            else {
+                if (color == 1 && test(child, -color, score, 0))
+                    score = scout(child, -color);
+                if (color == -1 && !test(child, -color, score, 1))
+                    score = scout(child, -color);
+            }
+        }
+        if (nmoves == 0)
+            score = scout(state, -color);
+
+        ++expanded;
+        return score;
+    }
+
+    int negascout(const state_t &state, int alpha, int beta, int color) {
+        ++generated;
+        if (state.terminal())
+            return color * state.value();
+
+        int score;
+        int moves[DIM];
+        int nmoves = color == 1 ? MG::template generate<true>(state, moves) : MG::template generate<false>(state, moves);
+        for (int i = 0; i < nmoves; ++i) {
+            auto child = state.move(color == 1, moves[i]);
+            if (i == 0)
+                score = -negascout(child, -beta, -alpha, -color);
+            else {
+                score = -negascout(child, -alpha - 1, -alpha, -color);
+                if (alpha < score && score < beta)
+                    score = -negascout(child, -beta, -score, -color);
+            }
+
+            alpha = std::max(alpha, score);
+            if (alpha >= beta)
+                break;
+        }
+
+        if (nmoves == 0)
+            alpha = -negascout(state, -beta, -alpha, -color);
+
+        ++expanded;
+        return alpha;
+    }
+
+    int mtdf(const state_t &root, int color, int f) {
+        int bound[2] = { -INF, INF};
+        uint64_t key = root.pack();
+        do {
+            int beta = f + (f == bound[0]);
+            f = negamax(root, key, beta - 1, beta, color, true);
+            bound[f < beta] = f;
+        } while (bound[0] < bound[1]);
+        return f;
+    }
+};
+
+struct bench_result_t {
+    unsigned long long generated;
+    float seconds;
+    int values[128];
+};
+
+bench_result_t run(Searcher &searcher, int algorithm, bool use_tt, int f, const state_t *pv, int npositions) {
+    bench_result_t result = { 0, 0, { } };
+    search_limits_t limits;
+    limits.use_tt = use_tt;
+    limits.mtdf_guess = f;
+    limits.want_pv = false;
+    for ( int i = 0; i < npositions; ++i ) {
+        searcher.clear();
+        int color = i % 2 == 1 ? 1 : -1;
+        search_result_t r = searcher.solve(pv[i], color, algorithm, limits);
+        result.values[i] = color * r.value;
+        result.seconds += r.stats.seconds;
+        result.generated += r.stats.generated;
+    }
+    return result;
+}
+
+bench_result_t run(reference_t<scan_movegen_t> &reference, int algorithm, bool use_tt, int f, const state_t *pv, int npositions) {
+    bench_result_t result = { 0, 0, { } };
+    for ( int i = 0; i < npositions; ++i ) {
+        int color = i % 2 == 1 ? 1 : -1;
+        float start_time = Utils::read_thread_time_in_seconds();
+        int value = reference.solve(pv[i], color, algorithm, use_tt, f);
+        result.seconds += Utils::read_thread_time_in_seconds() - start_time;
+        result.values[i] = color * value;
+        result.generated += reference.generated;
+    }
+    return result;
+}
+
+int main(int argc, const char **argv) {
+    state_t pv[128];
+    int npv = build_pv(pv);
+    int npositions = argc > 1 ? atoi(argv[1]) : 14;
+    if ( npositions < 1 || npositions > npv + 1 ) npositions = npv + 1;
+
+    // the reference and one searcher per backend, living side by side
+    searcher_options_t options;
+    reference_t<scan_movegen_t> reference(options.tt_bytes);
+    options.movegen = MOVEGEN_VECTOR;
+    Searcher vector_searcher(options);
+    options.movegen = MOVEGEN_SCAN;
+    Searcher scan_searcher(options);
+    // touch the TTs before timing anything
+    vector_searcher.reserve();
+    scan_searcher.reserve();
+
+    struct { const char *name; int algorithm; bool use_tt; int f; } runs[] = {
+        { "Negamax (minmax)", 1, false, 0 },
+        { "Negamax (alpha-beta)", 2, false, 0 },
+        { "Negamax (alpha-beta) w/ TT", 2, true, 0 },
+        { "Scout", 3, false, 0 },
+        { "Negascout", 4, false, 0 },
+        { "SSS*", 5, false, 0 },
+        { "MTD(f) with -4", 6, true, -4 },
+    };
+
+    cout << "Benchmarking PV steps " << npv + 1 << " down to " << npv + 2 - npositions << endl;
+    cout << left << setw(28) << "algorithm"
+         << right << setw(14) << "#generated"
+         << setw(14) << "runtime flags" << setw(14) << "specialised"
+         << setw(10) << "speedup" << setw(14) << vector_movegen_t::name() << endl;
+
+    for ( auto &r : runs ) {
+        bool has_reference = r.algorithm != SSS_STAR;
+        bench_result_t s = run(scan_searcher, r.algorithm, r.use_tt, r.f, pv, npositions);
+        bench_result_t v = run(vector_searcher, r.algorithm, r.use_tt, r.f, pv, npositions);
+        bench_result_t f = has_reference ? run(reference, r.algorithm, r.use_tt, r.f, pv, npositions) : s;
+        for ( int i = 0; i < npositions; ++i ) {
+            if ( v.values[i] != s.values[i] || f.values[i] != s.values[i] ) {
+                cerr << "error: kernels disagree on " << r.name << " at step " << npv + 1 - i << endl;
+                return 1;
+            }
+        }
+        // SSS* counts may vary run to run (ties on node addresses)
+        if ( r.algorithm != SSS_STAR && (v.generated != s.generated || f.generated != s.generated) ) {
+            cerr << "error: kernels disagree on the #generated of " << r.name << endl;
+            return 1;
+        }
+
+        // nodes per second of each kernel, and what specialisation buys
+        double s_rate = s.generated / max(s.seconds, 1e-6f);
+        double v_rate = v.generated / max(v.seconds, 1e-6f);
+        double f_rate = f.generated / max(f.seconds, 1e-6f);
+        cout << left << setw(28) << r.name
+             << right << setw(14) << s.generated << setprecision(4);
+        if ( has_reference ) cout << setw(14) << f_rate;
+        else cout << setw(14) << "-";
+        cout << setw(14) << s_rate;
+        if ( has_reference ) cout << setw(9) << setprecision(3) << s_rate / f_rate << "x";
+        else cout << setw(10) << "-";
+        cout << setw(14) << setprecision(4) << v_rate << endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,417 @@
+// Game of Othello -- distributed root-splitting solver
+// Universidad Simon Bolivar, 2012.
+//
+// Solves a PV position by splitting it into independent work units that
+// any number of worker processes sharing a directory can solve:
+//
+//   dsolve split <dir> <step> <depth>   expand PV step <step> (34..1, as
+//                                       printed by main) to depth <depth>
+//                                       and write one unit per frontier node
+//   dsolve [-a alg] [-t] [-f guess] work <dir>
+//                                       claim and solve units until none
+//                                       are left (alg numbered as in main)
+//   dsolve recover <dir>                requeue units claimed by dead workers
+//   dsolve merge <dir>                  back the results up to the root
+//
+// Layout of <dir>:
+//   root            color and packed position (state_t::pack, in
+//                   decimal) of the split position
+//   manifest        ids of all frontier nodes, written last by split
+//   pending/<id>    unit waiting for a worker: color packed-position
+//   claimed/<id>@<host>.<pid>
+//                   unit being solved; claimed with an atomic rename
+//   done/<id>       result: value type, from the unit's side to move
+//
+// A unit id is its path from the root: "u" followed by "-MM" for each
+// move (36 is a pass), so sorting ids gives the left-to-right order of
+// alpha-beta. Before solving a unit a worker backs up the results that
+// are already in done/ to derive its alpha-beta window, so units finished
+// earlier tighten (or cut off) those solved later. Every file is written
+// to a temporary name and renamed into place, so a crash at any point
+// loses at most the units being solved; rerunning split, work or recover
+// resumes from what is on disk.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "othello_cut.h"
+#include "searcher.h"
+
+using namespace std;
+
+enum { CUT = UPPER + 1 };
+const char *type_names[] = { "EXACT", "LOWER", "UPPER", "CUT" };
+
+struct unit_t {
+    int color;
+    state_t state;
+};
+
+// node of the split tree, rebuilt from the manifest
+struct tree_node_t {
+    map<int, tree_node_t> children;
+    string id;
+    bool leaf = false;
+    int lower = -INF, upper = INF;
+};
+
+string unit_id(const vector<int> &path) {
+    string id = "u";
+    char buf[8];
+    for ( int m : path ) {
+        snprintf(buf, sizeof(buf), "-%02d", m);
+        id += buf;
+    }
+    return id;
+}
+
+vector<int> unit_path(const string &id) {
+    vector<int> path;
+    for ( size_t i = 1; i + 3 <= id.size(); i += 3 )
+        path.push_back(atoi(id.substr(i + 1, 2).c_str()));
+    return path;
+}
+
+bool write_file(const string &path, const string &content) {
+    string tmp = path + ".tmp." + to_string(getpid());
+    ofstream os(tmp.c_str());
+    os << content;
+    os.close();
+    if ( !os || rename(tmp.c_str(), path.c_str()) != 0 ) {
+        cerr << "error: cannot write " << path << ": " << strerror(errno) << endl;
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool read_unit(const string &path, unit_t &unit) {
+    ifstream is(path.c_str());
+    uint64_t key;
+    if ( !(is >> unit.color >> key) ) return false;
+    unit.state = state_t::unpack(key);
+    return true;
+}
+
+string format_unit(const unit_t &unit) {
+    ostringstream os;
+    os << unit.color << " " << unit.state.pack() << endl;
+    return os.str();
+}
+
+string format_result(int value, int type) {
+    return to_string(value) + " " + type_names[type] + "\n";
+}
+
+vector<string> list_dir(const string &path) {
+    vector<string> names;
+    DIR *dir = opendir(path.c_str());
+    if ( dir == nullptr ) return names;
+    while ( struct dirent *e = readdir(dir) ) {
+        if ( e->d_name[0] != '.' && strstr(e->d_name, ".tmp.") == nullptr )
+            names.push_back(e->d_name);
+    }
+    closedir(dir);
+    sort(names.begin(), names.end());
+    return names;
+}
+
+string host_name() {
+    char buf[256];
+    if ( gethostname(buf, sizeof(buf)) != 0 ) return "localhost";
+    buf[sizeof(buf) - 1] = 0;
+    return buf;
+}
+
+// Split
+
+// Returns false as soon as a unit cannot be written.
+bool split(const string &dir, const state_t &state, int color, vector<int> &path, int depth, vector<string> &manifest) {
+    string id = unit_id(path);
+    if ( state.terminal() ) {
+        // nothing to distribute: record the leaf as solved
+        manifest.push_back(id);
+        return write_file(dir + "/done/" + id, format_result(color * state.value(), EXACT));
+    }
+    if ( depth == 0 ) {
+        manifest.push_back(id);
+        return write_file(dir + "/pending/" + id, format_unit({ color, state }));
+    }
+
+    vector<int> moves = state.get_moves(color == 1);
+    if ( moves.empty() ) moves.push_back(DIM); // pass
+    for ( int m : moves ) {
+        path.push_back(m);
+        bool ok = split(dir, state.move(color == 1, m), -color, path, depth - 1, manifest);
+        path.pop_back();
+        if ( !ok ) return false;
+    }
+    return true;
+}
+
+int do_split(const string &dir, int step, int depth) {
+    state_t pv[128];
+    int npv = build_pv(pv);
+    int i = npv + 1 - step;
+    if ( i < 0 || i > npv || depth < 0 ) {
+        cerr << "error: step must be in 1.." << npv + 1 << " and depth >= 0" << endl;
+        return 1;
+    }
+    if ( access((dir + "/manifest").c_str(), F_OK) == 0 ) {
+        cout << dir << " is already split" << endl;
+        return 0;
+    }
+
+    int color = i % 2 == 1 ? 1 : -1;
+    for ( const char *sub : { "", "/pending", "/claimed", "/done" } ) {
+        if ( mkdir((dir + sub).c_str(), 0777) != 0 && errno != EEXIST ) {
+            cerr << "error: cannot create " << dir + sub << ": " << strerror(errno) << endl;
+            return 1;
+        }
+    }
+    if ( !write_file(dir + "/root", format_unit({ color, pv[i] })) ) return 1;
+
+    vector<string> manifest;
+    vector<int> path;
+    // without a manifest the directory is not split, and split runs again
+    if ( !split(dir, pv[i], color, path, depth, manifest) ) return 1;
+
+    string content;
+    for ( auto &id : manifest ) content += id + "\n";
+    if ( !write_file(dir + "/manifest", content) ) return 1;
+
+    cout << "Split step " << step << " (" << (color == 1 ? "Black" : "White") << " moves) at depth "
+         << depth << " into " << manifest.size() << " units" << endl;
+    return 0;
+}
+
+// Backing up results
+
+bool read_manifest(const string &dir, tree_node_t &root) {
+    ifstream is((dir + "/manifest").c_str());
+    if ( !is ) {
+        cerr << "error: " << dir << " has no manifest; run split first" << endl;
+        return false;
+    }
+    string id;
+    while ( is >> id ) {
+        tree_node_t *node = &root;
+        for ( int m : unit_path(id) ) node = &node->children[m];
+        node->id = id;
+        node->leaf = true;
+    }
+    return true;
+}
+
+// Recomputes lower/upper bounds of every node (negamax values, from the
+// side to move) from the results in done/. Returns the number of leaves
+// that have no result yet.
+int back_up(const string &dir, tree_node_t &node) {
+    if ( node.leaf ) {
+        node.lower = -INF;
+        node.upper = INF;
+        ifstream is((dir + "/done/" + node.id).c_str());
+        int value;
+        string type;
+        if ( !(is >> value >> type) ) return 1;
+        if ( type == "EXACT" || type == "LOWER" ) node.lower = value;
+        if ( type == "EXACT" || type == "UPPER" ) node.upper = value;
+        return 0;
+    }
+
+    int missing = 0;
+    node.lower = node.upper = -INF;
+    for ( auto &c : node.children ) {
+        missing += back_up(dir, c.second);
+        node.lower = max(node.lower, -c.second.upper);
+        node.upper = max(node.upper, -c.second.lower);
+    }
+    return missing;
+}
+
+// Alpha-beta window for the leaf at path, given the bounds of its
+// siblings and of the siblings of its ancestors.
+void window(tree_node_t &node, const vector<int> &path, size_t depth, int alpha, int beta, int &leaf_alpha, int &leaf_beta) {
+    if ( depth == path.size() ) {
+        leaf_alpha = alpha;
+        leaf_beta = beta;
+        return;
+    }
+    for ( auto &c : node.children ) {
+        if ( c.first != path[depth] ) alpha = max(alpha, -c.second.upper);
+    }
+    window(node.children[path[depth]], path, depth + 1, -beta, -alpha, leaf_alpha, leaf_beta);
+}
+
+// Work
+
+int recover(const string &dir, bool verbose) {
+    string host = host_name();
+    int requeued = 0;
+    for ( auto &name : list_dir(dir + "/claimed") ) {
+        size_t at = name.rfind('@'), dot = name.rfind('.');
+        if ( at == string::npos || dot == string::npos || dot < at ) continue;
+        if ( name.substr(at + 1, dot - at - 1) != host ) {
+            if ( verbose ) cout << "claim " << name << " belongs to another host, left alone" << endl;
+            continue;
+        }
+        pid_t pid = atoi(name.substr(dot + 1).c_str());
+        if ( kill(pid, 0) == 0 || errno != ESRCH ) continue;
+
+        string id = name.substr(0, at);
+        string from = dir + "/claimed/" + name;
+        if ( access((dir + "/done/" + id).c_str(), F_OK) == 0 ) {
+            unlink(from.c_str());
+        } else if ( rename(from.c_str(), (dir + "/pending/" + id).c_str()) == 0 ) {
+            ++requeued;
+            if ( verbose ) cout << "requeued " << id << " (worker " << pid << " is gone)" << endl;
+        }
+    }
+    return requeued;
+}
+
+int do_work(const string &dir, int algorithm, bool use_tt, int f) {
+    tree_node_t root;
+    if ( !read_manifest(dir, root) ) return 1;
+    recover(dir, true);
+
+    string suffix = "@" + host_name() + "." + to_string(getpid());
+    Searcher searcher;
+    search_limits_t limits;
+    limits.use_tt = use_tt;
+    limits.mtdf_guess = f;
+    limits.want_pv = false;
+    int solved = 0, cut = 0;
+    while ( true ) {
+        // claim the leftmost pending unit; losing a race just means trying the next one
+        string id, claim;
+        for ( auto &name : list_dir(dir + "/pending") ) {
+            claim = dir + "/claimed/" + name + suffix;
+            if ( rename((dir + "/pending/" + name).c_str(), claim.c_str()) == 0 ) {
+                id = name;
+                break;
+            }
+        }
+        if ( id.empty() ) break;
+
+        unit_t unit;
+        if ( access((dir + "/done/" + id).c_str(), F_OK) == 0 ) {
+            unlink(claim.c_str());
+            continue;
+        }
+        if ( !read_unit(claim, unit) ) {
+            cerr << "error: cannot read unit " << id << endl;
+            return 1;
+        }
+
+        int alpha, beta;
+        back_up(dir, root);
+        window(root, unit_path(id), 0, -INF, INF, alpha, beta);
+
+        // the algorithms without a window just return exact values
+        search_result_t result;
+        int type = CUT;
+        if ( alpha < beta ) {
+            limits.alpha = alpha;
+            limits.beta = beta;
+            result = searcher.solve(unit.state, unit.color, algorithm, limits);
+            type = result.type;
+            ++solved;
+        } else {
+            ++cut;
+        }
+        int value = result.value;
+
+        if ( !write_file(dir + "/done/" + id, format_result(value, type)) ) return 1;
+        unlink(claim.c_str());
+
+        cout << id << ": window=[" << alpha << "," << beta << "]"
+             << ", value=" << value << " " << type_names[type]
+             << ", #generated=" << result.stats.generated
+             << ", seconds=" << result.stats.seconds
+             << endl;
+    }
+
+    cout << "No pending units left: solved " << solved << ", cut off " << cut << endl;
+    return 0;
+}
+
+// Merge
+
+int do_merge(const string &dir) {
+    tree_node_t root;
+    unit_t unit;
+    if ( !read_manifest(dir, root) ) return 1;
+    if ( !read_unit(dir + "/root", unit) ) {
+        cerr << "error: cannot read " << dir << "/root" << endl;
+        return 1;
+    }
+
+    int missing = back_up(dir, root);
+    if ( missing > 0 ) {
+        cout << missing << " units unsolved (" << list_dir(dir + "/pending").size() << " pending, "
+             << list_dir(dir + "/claimed").size() << " claimed)" << endl;
+        return 1;
+    }
+    if ( root.lower != root.upper ) {
+        cerr << "error: root is only bounded to [" << root.lower << "," << root.upper << "]" << endl;
+        return 1;
+    }
+
+    int best = -1;
+    for ( auto &c : root.children ) {
+        if ( -c.second.upper == root.lower && -c.second.lower == root.lower ) {
+            best = c.first;
+            break;
+        }
+    }
+    cout << (unit.color == 1 ? "Black" : "White") << " moves: value=" << unit.color * root.lower;
+    if ( best != -1 ) cout << ", best move=" << best;
+    cout << endl;
+    return 0;
+}
+
+int usage() {
+    cerr << "usage: dsolve split <dir> <step> <depth>" << endl
+         << "       dsolve [-a algorithm] [-t] [-f guess] work <dir>" << endl
+         << "       dsolve recover <dir>" << endl
+         << "       dsolve merge <dir>" << endl;
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    int algorithm = 2, f = 0;
+    bool use_tt = false;
+    int opt;
+    while ( (opt = getopt(argc, argv, "a:tf:")) != -1 ) {
+        if ( opt == 'a' ) algorithm = atoi(optarg);
+        else if ( opt == 't' ) use_tt = true;
+        else if ( opt == 'f' ) f = atoi(optarg);
+        else return usage();
+    }
+    if ( argc - optind < 2 ) return usage();
+
+    string command = argv[optind], dir = argv[optind + 1];
+    if ( command == "split" && argc - optind == 4 )
+        return do_split(dir, atoi(argv[optind + 2]), atoi(argv[optind + 3]));
+    else if ( command == "work" && algorithm >= 1 && algorithm <= 6 )
+        return do_work(dir, algorithm, use_tt || algorithm == 6, f);
+    else if ( command == "recover" ) {
+        int requeued = recover(dir, true);
+        cout << "Requeued " << requeued << " units" << endl;
+        return 0;
+    } else if ( command == "merge" )
+        return do_merge(dir);
+    return usage();
+}
@@ -0,0 +1,183 @@
+// Game of Othello -- load generator for the analysis server
+// Universidad Simon Bolivar, 2012.
+//
+// Usage: loadgen [-c connections] [-n requests] [-d depth] [-a algorithm]
+//                [-s step] [-r plies] [-p] socket-path
+//   -c  concurrent connections, one thread each (default 4)
+//   -n  requests per connection (default 1000)
+//   -d  requests kept in flight per connection (default 8)
+//   -a  algorithm, numbered as in main (default 2, with TT)
+//   -s  positions come from PV steps 34 down to <step> (default 20)
+//   -r  random plies played from the PV position (default 2)
+//   -p  ask for the PV too
+//
+// Reports throughput and the latency distribution, measured from when a
+// request is written to when its answer is read.
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "othello_cut.h"
+#include "protocol.h"
+
+using namespace std;
+typedef chrono::steady_clock clock_type;
+
+struct loadgen_options_t {
+    const char *path;
+    int requests = 1000;
+    int depth = 8;
+    int algorithm = 2;
+    int step = 20;
+    int plies = 2;
+    bool want_pv = false;
+};
+
+struct client_result_t {
+    vector<double> latencies;   // milliseconds
+    int errors = 0;
+    int aborted = 0;
+    int from_book = 0;
+};
+
+bool io_all(int fd, uint8_t *buf, size_t size, bool writing) {
+    for ( size_t done = 0; done < size; ) {
+        ssize_t n = writing ? send(fd, buf + done, size - done, MSG_NOSIGNAL) : read(fd, buf + done, size - done);
+        if ( n < 0 && errno == EINTR ) continue;
+        if ( n <= 0 ) return false;
+        done += n;
+    }
+    return true;
+}
+
+// A PV position at least opt.step plies from the start, then a few random plies.
+request_t random_request(const loadgen_options_t &opt, const state_t *pv, int npv, mt19937 &rng) {
+    request_t r;
+    int i = uniform_int_distribution<int>(0, npv + 1 - opt.step)(rng);
+    r.state = pv[i];
+    r.color = i % 2 == 1 ? 1 : -1;
+    for ( int k = 0; k < opt.plies && !r.state.terminal(); ++k ) {
+        vector<int> moves = r.state.get_moves(r.color == 1);
+        if ( !moves.empty() )
+            r.state = r.state.move(r.color == 1, moves[uniform_int_distribution<int>(0, moves.size() - 1)(rng)]);
+        r.color = -r.color;
+    }
+    r.algorithm = opt.algorithm;
+    r.flags = REQ_USE_TT | (opt.want_pv ? REQ_WANT_PV : 0);
+    return r;
+}
+
+void client(const loadgen_options_t &opt, int index, client_result_t &result) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, opt.path, sizeof(addr.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if ( fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ) {
+        cerr << "error: cannot connect to " << opt.path << ": " << strerror(errno) << endl;
+        result.errors = opt.requests;
+        if ( fd >= 0 ) close(fd);
+        return;
+    }
+
+    state_t pv[128];
+    int npv = build_pv(pv);
+    mt19937 rng(index + 1);
+    vector<clock_type::time_point> sent_at(opt.requests);
+
+    int sent = 0, received = 0;
+    while ( received < opt.requests ) {
+        // keep the pipeline full, then wait for one answer
+        for ( ; sent < opt.requests && sent - received < opt.depth; ++sent ) {
+            request_t r = random_request(opt, pv, npv, rng);
+            r.id = sent;
+            uint8_t buf[REQUEST_SIZE];
+            encode(r, buf);
+            sent_at[sent] = clock_type::now();
+            if ( !io_all(fd, buf, sizeof(buf), true) ) break;
+        }
+
+        uint8_t buf[RESPONSE_SIZE];
+        if ( !io_all(fd, buf, sizeof(buf), false) ) {
+            result.errors += opt.requests - received;
+            break;
+        }
+        response_t response;
+        decode(buf, response);
+        ++received;
+        if ( response.id >= uint32_t(opt.requests) || response.status == STATUS_BAD_REQUEST || response.status == STATUS_ERROR ) {
+            ++result.errors;
+            continue;
+        }
+        chrono::duration<double, milli> latency = clock_type::now() - sent_at[response.id];
+        result.latencies.push_back(latency.count());
+        result.aborted += response.status == STATUS_ABORTED;
+        result.from_book += (response.flags & RESP_FROM_BOOK) != 0;
+    }
+    close(fd);
+}
+
+int main(int argc, char **argv) {
+    loadgen_options_t opt;
+    int connections = 4;
+    int c;
+    while ( (c = getopt(argc, argv, "c:n:d:a:s:r:p")) != -1 ) {
+        if ( c == 'c' ) connections = max(1, atoi(optarg));
+        else if ( c == 'n' ) opt.requests = max(1, atoi(optarg));
+        else if ( c == 'd' ) opt.depth = max(1, atoi(optarg));
+        else if ( c == 'a' ) opt.algorithm = atoi(optarg);
+        else if ( c == 's' ) opt.step = atoi(optarg);
+        else if ( c == 'r' ) opt.plies = max(0, atoi(optarg));
+        else if ( c == 'p' ) opt.want_pv = true;
+        else return 1;
+    }
+    if ( optind + 1 != argc ) {
+        cerr << "usage: loadgen [-c connections] [-n requests] [-d depth] [-a algorithm] [-s step] [-r plies] [-p] socket-path" << endl;
+        return 1;
+    }
+    opt.path = argv[optind];
+    opt.step = min(max(opt.step, 1), 34);
+
+    vector<client_result_t> results(connections);
+    vector<thread> threads;
+    clock_type::time_point start = clock_type::now();
+    for ( int i = 0; i < connections; ++i )
+        threads.emplace_back(client, cref(opt), i, ref(results[i]));
+    for ( auto &t : threads ) t.join();
+    chrono::duration<double> wall = clock_type::now() - start;
+
+    vector<double> latencies;
+    int errors = 0, aborted = 0, from_book = 0;
+    for ( auto &r : results ) {
+        latencies.insert(latencies.end(), r.latencies.begin(), r.latencies.end());
+        errors += r.errors;
+        aborted += r.aborted;
+        from_book += r.from_book;
+    }
+    sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) {
+        return latencies.empty() ? 0.0 : latencies[min(latencies.size() - 1, size_t(p * latencies.size()))];
+    };
+
+    cout << "requests=" << latencies.size()
+         << ", errors=" << errors
+         << ", aborted=" << aborted
+         << ", from book=" << from_book
+         << ", seconds=" << wall.count()
+         << ", requests/second=" << latencies.size() / wall.count() << endl;
+    cout << fixed << setprecision(3)
+         << "latency (ms): p50=" << percentile(0.50)
+         << ", p90=" << percentile(0.90)
+         << ", p99=" << percentile(0.99)
+         << ", max=" << (latencies.empty() ? 0.0 : latencies.back()) << endl;
+    return errors > 0;
+}
@@ -0,0 +1,429 @@
+// Game of Othello -- macro benchmark suite
+// Universidad Simon Bolivar, 2012.
+//
+// Usage: macrobench [-N nodes] [-r repeats] [-s step] [-o file.json]
+//                   [-c baseline.json] [-l history] [-t percent] [-z score]
+//                   [-R dir]
+//   -N  budget of #generated per position (default 2000000, 0 = none)
+//   -r  repeats of each configuration (default 5)
+//   -s  walk the PV from step 34 down to <step> (default 1)
+//   -o  write the results as JSON
+//   -c  compare #generated with a JSON file written by -o
+//   -l  compare times with earlier runs on this machine, kept in <history>
+//   -t  smallest change of the median CPU time that counts (default 5)
+//   -z  smallest change, in standard deviations across runs (default 3)
+//   -R  also write main's log of each configuration into <dir>
+//
+// Every configuration solves the PV positions backwards, clearing the TT
+// before each one like main does, until a position exceeds the node
+// budget; that position and the ones before it are not counted. The node
+// budget makes the work of a configuration independent of machine speed,
+// so #generated must match the baseline exactly and only times may move.
+// The times in a -c baseline come from whatever machine wrote it and are
+// not compared.
+//
+// Times are compared with the history file instead, which keeps the
+// median CPU time of the last HISTORY runs of each configuration on this
+// machine and is not committed. Once a configuration has MIN_HISTORY runs
+// with its current #generated, a run is slower when its median exceeds
+// their mean by more than -t percent and more than -z times their
+// standard deviation, i.e. the noise between runs and not only within
+// one. Slower runs are not added to the history; delete the file to
+// accept a slowdown.
+//
+// Each configuration runs in a child process, so its peak RSS is its own.
+// The exit status is 1 when some configuration got slower or changed its
+// #generated.
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cerrno>
+#include <cstring>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "othello_cut.h"
+#include "searcher.h"
+
+using namespace std;
+typedef chrono::steady_clock clock_type;
+
+const size_t HISTORY = 10;
+const size_t MIN_HISTORY = 3;
+
+struct config_t {
+    const char *name;
+    const char *log;        // file name in Results/
+    const char *title;      // as main prints it
+    int algorithm;
+    bool use_tt;
+    int f;
+};
+
+const config_t configs[] = {
+    { "minmax", "minmax.txt", "Negamax (minmax version)", MINMAX, false, 0 },
+    { "negamax", "negamax.txt", "Negamax (alpha-beta version)", ALPHABETA, false, 0 },
+    { "negamax_tt", "negamax_tt.txt", "Negamax (alpha-beta version) w/ transposition table", ALPHABETA, true, 0 },
+    { "scout", "scout.txt", "Scout", SCOUT, false, 0 },
+    { "negascout", "negascout.txt", "Negascout", NEGASCOUT, false, 0 },
+    { "sss", "sss.txt", "SSS*", SSS_STAR, false, 0 },
+    { "mtdf_-4", "mdtf_-4.txt", "MTD(f) with -4 w/ transposition table", MTDF, true, -4 },
+    { "mtdf_16", "mdtf_16.txt", "MTD(f) with 16 w/ transposition table", MTDF, true, 16 },
+    { "mtdf_50", "mdtf_50.txt", "MTD(f) with 50 w/ transposition table", MTDF, true, 50 },
+};
+
+struct bench_options_t {
+    unsigned long long budget = 2000000;
+    int repeats = 5;
+    int step = 1;
+    string output, baseline, history, log_dir;
+    double threshold = 5;
+    double score = 3;
+};
+
+struct config_result_t {
+    string name;
+    int steps = 0;                  // positions solved within the budget
+    unsigned long long generated = 0, expanded = 0;
+    vector<double> cpu, wall;       // seconds, one per repeat
+    long peak_rss_kb = 0;
+};
+
+double median(vector<double> v) {
+    if ( v.empty() ) return 0;
+    sort(v.begin(), v.end());
+    size_t n = v.size();
+    return n % 2 == 1 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+double mean(const vector<double> &v) {
+    double sum = 0;
+    for ( double x : v ) sum += x;
+    return v.empty() ? 0 : sum / v.size();
+}
+
+double stddev(const vector<double> &v) {
+    if ( v.size() < 2 ) return 0;
+    double m = mean(v), sum = 0;
+    for ( double x : v ) sum += (x - m) * (x - m);
+    return sqrt(sum / (v.size() - 1));
+}
+
+// Runs one configuration in the calling process.
+config_result_t run(const config_t &config, const bench_options_t &opt, const state_t *pv, int npv) {
+    config_result_t result;
+    result.name = config.name;
+    Searcher searcher;
+    if ( config.use_tt ) searcher.reserve();  // page faults are not timed
+    search_limits_t limits;
+    limits.use_tt = config.use_tt;
+    limits.mtdf_guess = config.f;
+    limits.max_nodes = opt.budget;
+    limits.want_pv = false;
+
+    ofstream log;
+    if ( !opt.log_dir.empty() ) {
+        log.open((opt.log_dir + "/" + config.log).c_str());
+        log << "Extracting principal variation (PV) with " << npv << " plays ... done!" << endl
+            << "Algorithm: " << config.title << endl << "Moving along PV:" << endl;
+    }
+
+    for ( int r = 0; r < opt.repeats; ++r ) {
+        double cpu = 0, wall = 0;
+        unsigned long long generated = 0, expanded = 0;
+        int steps = 0;
+        for ( int i = 0; i <= npv + 1 - opt.step; ++i ) {
+            int color = i % 2 == 1 ? 1 : -1;
+            searcher.clear();
+            clock_type::time_point start = clock_type::now();
+            search_result_t s = searcher.solve(pv[i], color, config.algorithm, limits);
+            chrono::duration<double> elapsed = clock_type::now() - start;
+            if ( !s.complete ) break;
+
+            ++steps;
+            cpu += s.stats.seconds;
+            wall += elapsed.count();
+            generated += s.stats.generated;
+            expanded += s.stats.expanded;
+            if ( r == 0 && log.is_open() ) {
+                log << npv + 1 - i << ". " << (color == 1 ? "Black" : "White") << " moves: "
+                    << "value=" << color * s.value
+                    << ", #expanded=" << s.stats.expanded
+                    << ", #generated=" << s.stats.generated
+                    << ", seconds=" << s.stats.seconds
+                    << ", #generated/second=" << s.stats.generated / s.stats.seconds << endl;
+            }
+        }
+        result.steps = steps;
+        result.generated = generated;
+        result.expanded = expanded;
+        result.cpu.push_back(cpu);
+        result.wall.push_back(wall);
+    }
+    return result;
+}
+
+// Runs one configuration in a child process and collects its results
+// and peak RSS.
+bool run_child(const config_t &config, const bench_options_t &opt, const state_t *pv, int npv, config_result_t &result) {
+    int fds[2];
+    if ( pipe(fds) != 0 ) return false;
+    pid_t pid = fork();
+    if ( pid < 0 ) return false;
+    if ( pid == 0 ) {
+        close(fds[0]);
+        config_result_t r = run(config, opt, pv, npv);
+        ostringstream os;
+        os << setprecision(9) << r.steps << " " << r.generated << " " << r.expanded;
+        for ( int i = 0; i < opt.repeats; ++i ) os << " " << r.cpu[i] << " " << r.wall[i];
+        string s = os.str();
+        ssize_t n = write(fds[1], s.c_str(), s.size());
+        _exit(n == ssize_t(s.size()) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    string s;
+    char buf[4096];
+    for ( ssize_t n; (n = read(fds[0], buf, sizeof(buf))) > 0; ) s.append(buf, n);
+    close(fds[0]);
+    int status;
+    struct rusage usage;
+    if ( wait4(pid, &status, 0, &usage) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0 ) return false;
+
+    istringstream is(s);
+    result.name = config.name;
+    result.peak_rss_kb = usage.ru_maxrss;
+    is >> result.steps >> result.generated >> result.expanded;
+    for ( int i = 0; i < opt.repeats; ++i ) {
+        double cpu, wall;
+        is >> cpu >> wall;
+        result.cpu.push_back(cpu);
+        result.wall.push_back(wall);
+    }
+    return bool(is);
+}
+
+// One result per line, so that read_baseline does not need a JSON parser.
+void write_json(ostream &os, const bench_options_t &opt, const vector<config_result_t> &results) {
+    os << "{" << endl
+       << "  \"budget_generated\": " << opt.budget << "," << endl
+       << "  \"repeats\": " << opt.repeats << "," << endl
+       << "  \"last_step\": " << opt.step << "," << endl
+       << "  \"results\": [" << endl;
+    os << setprecision(9);
+    for ( size_t k = 0; k < results.size(); ++k ) {
+        const config_result_t &r = results[k];
+        double cpu = median(r.cpu);
+        os << "    {\"name\": \"" << r.name << "\""
+           << ", \"steps\": " << r.steps
+           << ", \"generated\": " << r.generated
+           << ", \"expanded\": " << r.expanded
+           << ", \"cpu_seconds\": [";
+        for ( size_t i = 0; i < r.cpu.size(); ++i ) os << (i ? ", " : "") << r.cpu[i];
+        os << "], \"wall_seconds\": [";
+        for ( size_t i = 0; i < r.wall.size(); ++i ) os << (i ? ", " : "") << r.wall[i];
+        os << "], \"cpu_median\": " << cpu
+           << ", \"cpu_stddev\": " << stddev(r.cpu)
+           << ", \"wall_median\": " << median(r.wall)
+           << ", \"generated_per_second\": " << (cpu > 0 ? r.generated / cpu : 0)
+           << ", \"peak_rss_kb\": " << r.peak_rss_kb
+           << "}" << (k + 1 < results.size() ? "," : "") << endl;
+    }
+    os << "  ]" << endl << "}" << endl;
+}
+
+// Value of "key" in a line written by write_json.
+string json_field(const string &line, const string &key) {
+    size_t p = line.find("\"" + key + "\": ");
+    if ( p == string::npos ) return "";
+    p += key.size() + 4;
+    size_t end = line[p] == '[' ? line.find(']', p) + 1 : line.find_first_of(",}", p);
+    return line.substr(p, end - p);
+}
+
+bool read_baseline(const string &path, map<string, config_result_t> &baseline, unsigned long long &budget) {
+    ifstream is(path.c_str());
+    if ( !is ) return false;
+    string line;
+    while ( getline(is, line) ) {
+        if ( line.find("\"budget_generated\"") != string::npos )
+            budget = strtoull(json_field(line, "budget_generated").c_str(), nullptr, 10);
+        string name = json_field(line, "name");
+        if ( name.size() < 2 ) continue;
+        config_result_t &r = baseline[name.substr(1, name.size() - 2)];
+        r.steps = atoi(json_field(line, "steps").c_str());
+        r.generated = strtoull(json_field(line, "generated").c_str(), nullptr, 10);
+    }
+    return true;
+}
+
+// Checks #generated against the baseline; returns the number of changes.
+int compare(const bench_options_t &opt, const vector<config_result_t> &results) {
+    map<string, config_result_t> baseline;
+    unsigned long long budget = 0;
+    if ( !read_baseline(opt.baseline, baseline, budget) ) {
+        cerr << "error: cannot read " << opt.baseline << endl;
+        return 1;
+    }
+    if ( budget != opt.budget )
+        cout << "warning: the baseline used a budget of " << budget << " nodes" << endl;
+
+    cout << endl << "Against " << opt.baseline << ":" << endl;
+    int changes = 0;
+    for ( const auto &r : results ) {
+        auto b = baseline.find(r.name);
+        cout << left << setw(12) << r.name << right;
+        if ( b == baseline.end() ) {
+            cout << "  not in the baseline" << endl;
+        } else if ( b->second.steps != r.steps || b->second.generated != r.generated ) {
+            cout << "  #generated changed: " << b->second.generated << " -> " << r.generated
+                 << " (" << b->second.steps << " -> " << r.steps << " steps)" << endl;
+            ++changes;
+        } else {
+            cout << "  same #generated" << endl;
+        }
+    }
+    return changes;
+}
+
+// History file: one line per configuration, "name generated median...",
+// oldest median first.
+struct history_t {
+    unsigned long long generated = 0;
+    vector<double> cpu;
+};
+
+// Compares times with the history and adds this run to it; returns the
+// number of regressions.
+int compare_history(const bench_options_t &opt, const vector<config_result_t> &results) {
+    map<string, history_t> history;
+    ifstream is(opt.history.c_str());
+    string line;
+    while ( getline(is, line) ) {
+        istringstream ls(line);
+        string name;
+        history_t h;
+        if ( !(ls >> name >> h.generated) ) continue;
+        for ( double x; ls >> x; ) h.cpu.push_back(x);
+        history[name] = h;
+    }
+    is.close();
+
+    cout << endl << "Against earlier runs in " << opt.history << ":" << endl;
+    int regressions = 0;
+    for ( const auto &r : results ) {
+        history_t &h = history[r.name];
+        if ( h.generated != r.generated ) h = history_t();  // other work: start over
+        h.generated = r.generated;
+        double cpu = median(r.cpu);
+        cout << left << setw(12) << r.name << right;
+        if ( h.cpu.size() < MIN_HISTORY ) {
+            cout << "  " << h.cpu.size() << " earlier runs, need " << MIN_HISTORY << endl;
+            h.cpu.push_back(cpu);
+            continue;
+        }
+
+        double m = mean(h.cpu), sd = stddev(h.cpu);
+        double change = m > 0 ? 100 * (cpu / m - 1) : 0;
+        double sds = sd > 0 ? (cpu - m) / sd : 0;
+        bool significant = fabs(change) >= opt.threshold && fabs(cpu - m) >= opt.score * sd;
+        cout << fixed << setprecision(4) << setw(10) << m << "s -> " << setw(8) << cpu << "s"
+             << setprecision(1) << showpos << setw(8) << change << "%" << noshowpos
+             << "  " << setprecision(2) << sds << " sd" << defaultfloat;
+        if ( significant && change > 0 ) {
+            cout << "  SLOWER" << endl;
+            ++regressions;
+            continue;
+        }
+        if ( significant ) cout << "  faster";
+        cout << endl;
+        h.cpu.push_back(cpu);
+    }
+
+    ofstream os(opt.history.c_str());
+    os << setprecision(9);
+    for ( auto &e : history ) {
+        vector<double> &v = e.second.cpu;
+        if ( v.size() > HISTORY ) v.erase(v.begin(), v.end() - HISTORY);
+        os << e.first << " " << e.second.generated;
+        for ( double x : v ) os << " " << x;
+        os << endl;
+    }
+    if ( !os ) cerr << "warning: cannot write " << opt.history << endl;
+    return regressions;
+}
+
+int main(int argc, char **argv) {
+    bench_options_t opt;
+    int c;
+    while ( (c = getopt(argc, argv, "N:r:s:o:c:l:t:z:R:")) != -1 ) {
+        if ( c == 'N' ) opt.budget = strtoull(optarg, nullptr, 10);
+        else if ( c == 'r' ) opt.repeats = max(1, atoi(optarg));
+        else if ( c == 's' ) opt.step = atoi(optarg);
+        else if ( c == 'o' ) opt.output = optarg;
+        else if ( c == 'c' ) opt.baseline = optarg;
+        else if ( c == 'l' ) opt.history = optarg;
+        else if ( c == 't' ) opt.threshold = atof(optarg);
+        else if ( c == 'z' ) opt.score = atof(optarg);
+        else if ( c == 'R' ) opt.log_dir = optarg;
+        else return 1;
+    }
+    if ( optind != argc ) {
+        cerr << "usage: macrobench [-N nodes] [-r repeats] [-s step] [-o file.json] [-c baseline.json] [-l history] [-t percent] [-z score] [-R dir]" << endl;
+        return 1;
+    }
+
+    if ( !opt.log_dir.empty() && mkdir(opt.log_dir.c_str(), 0755) != 0 && errno != EEXIST ) {
+        cerr << "error: cannot create " << opt.log_dir << endl;
+        return 1;
+    }
+
+    state_t pv[128];
+    int npv = build_pv(pv);
+    opt.step = min(max(opt.step, 1), npv + 1);
+
+    cout << "Budget of " << opt.budget << " nodes per position, " << opt.repeats << " repeats, PV steps "
+         << npv + 1 << " down to " << opt.step << endl;
+    cout << left << setw(12) << "config"
+         << right << setw(7) << "steps" << setw(14) << "#generated"
+         << setw(11) << "cpu (s)" << setw(9) << "+-" << setw(11) << "wall (s)"
+         << setw(14) << "#gen/second" << setw(12) << "RSS (KB)" << endl;
+
+    vector<config_result_t> results;
+    for ( const config_t &config : configs ) {
+        config_result_t r;
+        if ( !run_child(config, opt, pv, npv, r) ) {
+            cerr << "error: " << config.name << " failed" << endl;
+            return 1;
+        }
+        double cpu = median(r.cpu);
+        cout << left << setw(12) << r.name
+             << right << setw(7) << r.steps << setw(14) << r.generated
+             << fixed << setprecision(4) << setw(11) << cpu << setw(9) << stddev(r.cpu)
+             << setw(11) << median(r.wall) << defaultfloat
+             << setw(14) << setprecision(4) << (cpu > 0 ? r.generated / cpu : 0)
+             << setw(12) << r.peak_rss_kb << endl;
+        results.push_back(r);
+    }
+
+    int regressions = opt.baseline.empty() ? 0 : compare(opt, results);
+    if ( !opt.history.empty() ) regressions += compare_history(opt, results);
+    if ( !opt.output.empty() ) {
+        ofstream os(opt.output.c_str());
+        write_json(os, opt, results);
+        if ( !os ) {
+            cerr << "error: cannot write " << opt.output << endl;
+            return 1;
+        }
+    }
+    return regressions > 0;
+}
@@ -6,69 +6,97 @@
 
 #include <iostream>
 #include <limits>
+#include <string>
+#include <unistd.h>
 #include "othello_cut.h" // won't work correctly until .h is fixed!
 #include "utils.h"
-
-#include <unordered_map>
-#include <list>
-#include <queue>
-#include <set>
+#include "searcher.h"
+#include "batch.h"
 
 using namespace std;
 
-unsigned long long expanded = 0;
-unsigned long long generated = 0;
-int tt_threshold = 32; // threshold to save entries in TT
-const int INF = 200;
-
-// Transposition table (it is not necessary to implement TT)
-enum { EXACT, LOWER, UPPER };
-struct stored_info_t {
-    int value_;
-    int type_;
-    stored_info_t(int value = -100, int type = LOWER) : value_(value), type_(type) { }
-};
-
-struct hash_function_t {
-    size_t operator()(const state_t &state) const {
-        return state.hash();
-    }
-};
-
-class hash_table_t : public unordered_map<state_t, stored_info_t, hash_function_t> {
-};
-
-hash_table_t TTable[2];
-
-//int maxmin(state_t state, int depth, bool use_tt);
-//int minmax(state_t state, int depth, bool use_tt = false);
-//int maxmin(state_t state, int depth, bool use_tt = false);
-int negamax(state_t state, int color);
-int negamax(state_t state, int alpha, int beta, int color, bool use_tt = false);
-int scout(state_t state, int color);
-int negascout(state_t state, int alpha, int beta, int color);
-int sss_star(state_t state, int color, int bound);
-int mtdf(state_t root, int color, int f);
-
-int main(int argc, const char **argv) {
+// Usage: main [options] algorithm [tt | f]
+//        main [options] -a algorithm [-t] [-f guess] [-i file [batch options]]
+//   -m  RAM for each transposition table (default 256)
+//   -s  enable the second TT level in spill-file.0 and spill-file.1
+//   -S  size of each spill file (default 4096; they are sparse)
+//   -a  algorithm: 1 minmax, 2 alpha-beta, 3 scout, 4 negascout, 5 SSS*, 6 MTD(f)
+//   -t  use the transposition table
+//   -f  first guess of MTD(f) (implies -t)
+//   -D  print the PV positions in the batch text format and exit
+// Batch mode (see batch.h) solves the positions in a file instead of the PV:
+//   -i  input file, - for stdin
+//   -I  input format: text (default) or bin
+//   -o  output file (default stdout)
+//   -O  output format: csv (default) or bin
+//   -j  worker threads (default 1); with -s, thread i uses spill-file.<i>.0/.1
+//   -N  max #generated per position
+//   -T  max CPU seconds per position
+//   -B  report the best move too
+int main(int argc, char **argv) {
     state_t pv[128];
     int npv = 0;
     for ( int i = 0; PV[i] != -1; ++i ) ++npv;
 
+    searcher_options_t options;
+    batch_options_t batch;
+    search_limits_t limits;
     int algorithm = 0;
+    bool use_tt = false, batch_mode = false, dump_pv = false;
+    int opt;
+    while ( (opt = getopt(argc, argv, "+m:s:S:a:tf:Di:I:o:O:j:N:T:B")) != -1 ) {
+        if ( opt == 'm' ) options.tt_bytes = size_t(atol(optarg)) << 20;
+        else if ( opt == 's' ) options.spill_path = optarg;
+        else if ( opt == 'S' ) options.spill_bytes = size_t(atol(optarg)) << 20;
+        else if ( opt == 'a' ) algorithm = atoi(optarg);
+        else if ( opt == 't' ) use_tt = true;
+        else if ( opt == 'f' ) use_tt = true, limits.mtdf_guess = atoi(optarg);
+        else if ( opt == 'D' ) dump_pv = true;
+        else if ( opt == 'i' ) batch_mode = true, batch.input = optarg;
+        else if ( opt == 'I' ) batch.binary_input = string(optarg) == "bin";
+        else if ( opt == 'o' ) batch.output = optarg;
+        else if ( opt == 'O' ) batch.binary_output = string(optarg) == "bin";
+        else if ( opt == 'j' ) batch.threads = max(1, atoi(optarg));
+        else if ( opt == 'N' ) limits.max_nodes = atoll(optarg);
+        else if ( opt == 'T' ) limits.max_seconds = atof(optarg);
+        else if ( opt == 'B' ) batch.best_move = true;
+        else return 1;
+    }
+    argc -= optind - 1;
+    argv += optind - 1;
+
+    // legacy positionals: algorithm [tt | f]
     if ( argc > 1 ) algorithm = atoi(argv[1]);
-    bool use_tt = argc > 2;
+    if ( argc > 2 ) {
+        use_tt = true;
+        if ( algorithm == MTDF ) limits.mtdf_guess = atoi(argv[2]);
+    }
+
+    if ( dump_pv ) {
+        build_pv(pv);
+        for ( int i = npv; i >= 0; --i )
+            cout << format_position(pv[i], i % 2 == 1 ? 1 : -1) << endl;
+        return 0;
+    }
+
+    if ( algorithm < MINMAX || algorithm > MTDF || (algorithm == MTDF && !use_tt) ) {
+        cerr << "usage: main [-m MB] [-s spill-file [-S MB]] algorithm [tt | f]" << endl
+             << "       main [-m MB] [-s spill-file [-S MB]] -a algorithm [-t] [-f guess]" << endl
+             << "            [-i file [-I text|bin] [-o file] [-O csv|bin] [-j threads] [-N nodes] [-T seconds] [-B]]" << endl;
+        return 1;
+    }
+
+    if ( batch_mode ) {
+        limits.use_tt = use_tt;
+        batch.algorithm = algorithm;
+        batch.limits = limits;
+        batch.searcher = options;
+        return run_batch(batch);
+    }
 
     // Extract principal variation of the game
-    state_t state;
     cout << "Extracting principal variation (PV) with " << npv << " plays ... " << flush;
-    for ( int i = 0; PV[i] != -1; ++i ) {
-        bool player = i % 2 == 0; // black moves first!
-        int pos = PV[i];
-        pv[npv - i] = state;
-        state = state.move(player, pos);
-    }
-    pv[0] = state;
+    build_pv(pv);
     cout << "done!" << endl;
 
 #if 0
@@ -77,8 +105,9 @@ int main(int argc, const char **argv) {
         cout << pv[npv - i];
 #endif
 
-    // for MTD(f)
-    int f;
+    limits.want_pv = false;
+    limits.max_nodes = 0;
+    limits.max_seconds = 0;
 
     // Print name of algorithm
     cout << "Algorithm: ";
@@ -92,353 +121,45 @@ int main(int argc, const char **argv) {
         cout << "Negascout";
     else if ( algorithm == 5 )
         cout << "SSS*";
-    else if ( algorithm == 6 ) {
-        f = atoi(argv[2]);
-        cout << "MTD(f) with " << f;
-    }
+    else if ( algorithm == 6 )
+        cout << "MTD(f) with " << limits.mtdf_guess;
     cout << (use_tt ? " w/ transposition table" : "") << endl;
+    limits.use_tt = use_tt;
+    Searcher searcher(options);
+    if ( use_tt ) searcher.reserve();
 
     // Run algorithm along PV (bacwards)
     cout << "Moving along PV:" << endl;
     for ( int i = 0; i <= npv; ++i ) {
         //cout << pv[i];
-        int value = 0;
-        TTable[0].clear();
-        TTable[1].clear();
-        float start_time = Utils::read_time_in_seconds();
-        expanded = 0;
-        generated = 0;
+        search_result_t result;
+        searcher.clear();
         int color = i % 2 == 1 ? 1 : -1;
 
         try {
-            if ( algorithm == 1 ) {
-                value = color * negamax(pv[i], color);
-            } else if ( algorithm == 2 ) {
-                value = color * negamax(pv[i], -INF, INF, color, use_tt);
-            } else if ( algorithm == 3 ) {
-                value = scout(pv[i], color);
-            } else if ( algorithm == 4 ) {
-                value = color * negascout(pv[i], -INF, INF, color);
-            } else if (algorithm == 5 ) {
-                value = sss_star(pv[i], color, INF);
-            } else if (algorithm == 6) {
-                value = color * mtdf(pv[i], color, f);
-            }
+            result = searcher.solve(pv[i], color, algorithm, limits);
         } catch ( const bad_alloc &e ) {
-            cout << "size TT[0]: size=" << TTable[0].size() << ", #buckets=" << TTable[0].bucket_count() << endl;
-            cout << "size TT[1]: size=" << TTable[1].size() << ", #buckets=" << TTable[1].bucket_count() << endl;
-            use_tt = false;
+            cout << "size TT[0]: size=" << searcher.tt(-1).size() << ", capacity=" << searcher.tt(-1).capacity() << endl;
+            cout << "size TT[1]: size=" << searcher.tt(1).size() << ", capacity=" << searcher.tt(1).capacity() << endl;
+            limits.use_tt = false;
+        } catch ( const runtime_error &e ) {
+            cerr << "error: " << e.what() << endl;
+            return 1;
         }
 
-        float elapsed_time = Utils::read_time_in_seconds() - start_time;
-
+        const search_stats_t &stats = result.stats;
         cout << npv + 1 - i << ". " << (color == 1 ? "Black" : "White") << " moves: "
-             << "value=" <<  value
-             << ", #expanded=" << expanded
-             << ", #generated=" << generated
-             << ", seconds=" << elapsed_time
-             << ", #generated/second=" << generated / elapsed_time
-             << endl;
-    }
-
-    return 0;
-}
-
-
-int negamax(state_t state, int color) {
-    ++generated;
-    if (state.terminal())
-        return color * state.value();
-
-    int score = -INF;
-    // booleano para saber si logre moverme colocando alguna ficha
-    // o si tengo que pasar el turno al otro
-    bool moved = false;
-    for (int p : state.get_moves(color == 1)) {
-        moved = true;
-        score = max(
-                    score,
-                    -negamax(state.move(color == 1, p), -color)
-                );
-    }
-    // si no logre moverme sigo en el mismo estado pero cambio el color
-    if (!moved)
-        score = -negamax(state, -color);
-
-    ++expanded;
-    return score;
-}
-
-int negamax(state_t state, int alpha, int beta, int color, bool use_tt) {
-    ++generated;
-    int original_alpha = alpha;
-
-    if (use_tt && TTable[color == 1].find(state) != TTable[color == 1].end()) {
-        auto tup = TTable[color == 1][state];
-
-        if (tup.type_ == EXACT) {
-            return tup.value_;
-        }
-        else if (tup.type_ == UPPER) {
-            beta = min(beta, tup.value_);
+             << "value=" << color * result.value
+             << ", #expanded=" << stats.expanded
+             << ", #generated=" << stats.generated
+             << ", seconds=" << stats.seconds
+             << ", #generated/second=" << stats.generated / stats.seconds;
+        if ( !options.spill_path.empty() && limits.use_tt ) {
+            cout << ", #spilled=" << stats.spilled
+                 << ", #spill hits=" << stats.spill_hits;
         }
-        else if (tup.type_ == LOWER) {
-            alpha = max(alpha, tup.value_);
-        }
-
-        if (alpha >= beta)
-            return tup.value_;
-    }
-
-    if (state.terminal())
-        return color * state.value();
-
-    int score = -INF;
-    // booleano para saber si logre moverme colocando alguna ficha
-    // o si tengo que pasar el turno al otro
-    bool moved = false;
-    for (int p : state.get_moves(color == 1)) {
-        moved = true;
-        score = max(
-                    score,
-                    -negamax(state.move(color == 1, p), -beta, -alpha, -color, use_tt)
-                );
-        alpha = max(alpha, score);
-        if (alpha >= beta)
-            break;
+        cout << endl;
     }
-    // si no logre moverme sigo en el mismo estado pero cambio el color
-    if (!moved)
-        score = -negamax(state, -beta, -alpha, -color, use_tt);
-
-    if (use_tt) {
-        stored_info_t tup = {score, EXACT};
-        if (score <= original_alpha)
-            tup.type_ = UPPER;
-        else if (score >= beta)
-            tup.type_ = LOWER;
-        TTable[color == 1][state] = tup;
-    }
-
-    ++expanded;
-    return score;
-}
-
-// cond : 0 es > ; 1 es >=
-bool test(state_t state, int color, int score, bool cond) {
-
-    ++generated;
-    if (state.terminal())
-        return (cond ? state.value() >= score : state.value() > score);
-
-    ++expanded;
-    auto moves = state.get_moves(color == 1);
-    for (int i = 0; i < (int)moves.size(); ++i) {
-        auto child = state.move(color == 1, moves[i]);
-        if (color == 1 && test(child, -color, score, cond))
-            return true;
-        if (color == -1 && !test(child, -color, score, cond))
-            return false;
-    }
-
-    if (moves.size() == 0) {
-        if (color == 1 && test(state, -color, score, cond))
-            return true;
-        if (color == -1 && !test(state, -color, score, cond))
-            return false;
-    }
-
-    return color == -1;
-}
-
-int scout(state_t state, int color) {
-    ++generated;
-    if (state.terminal())
-        return state.value();
 
-    int score = 0;
-    auto moves = state.get_moves(color == 1);
-    for (int i = 0; i < (int)moves.size(); ++i) {
-        auto child = state.move(color == 1, moves[i]);
-        // primer hijo
-        if (i == 0)
-            score = scout(child, -color);
-        else {
-            if (color == 1 && test(child, -color, score, 0))
-                score = scout(child, -color);
-            if (color == -1 && !test(child, -color, score, 1))
-                score = scout(child, -color);
-        }
-    }
-    // no se logro poner fichas, pasar turno
-    if (moves.size() == 0)
-        score = scout(state, -color);
-
-    ++expanded;
-    return score;
-}
-
-int negascout(state_t state, int alpha, int beta, int color) {
-
-    ++generated;
-    if (state.terminal())
-        return color * state.value();
-
-    int score;
-    auto moves = state.get_moves(color == 1);
-    for (int i = 0; i < (int)moves.size(); ++i) {
-        auto child = state.move(color == 1, moves[i]);
-        // primer hijo
-        if (i == 0)
-            score = -negascout(child, -beta, -alpha, -color);
-        else {
-
-            score = -negascout(child, -alpha - 1, -alpha, -color);
-            if (alpha < score && score < beta)
-                score = -negascout(child, -beta, -score, -color);
-        }
-
-        alpha = max(alpha, score);
-        if (alpha >= beta)
-            break;
-    }
-
-    // no se logro poner fichas, pasar turno
-    if (moves.size() == 0)
-        alpha = -negascout(state, -beta, -alpha, -color);
-
-
-    ++expanded;
-    return alpha;
-}
-
-
-
-
-
-
-// SSS*
-struct sss_state {
-    state_t othello;
-    int color;
-    bool root;
-    bool ignore_c;
-    sss_state *father;
-    list<int> moves;
-
-    sss_state(state_t ot, sss_state *fat, int col) {
-        othello = ot;
-        father = fat;
-        color = col;
-        root = false;
-        ignore_c = false;
-
-        auto moves_aux = othello.get_moves(color == 1);
-        for (int i = 0; i < (int)moves_aux.size(); ++i)
-            moves.push_back(moves_aux[i]);
-        if (moves.size() == 0)
-            moves.push_back(INF);
-    }
-
-    bool ignore_childs() {
-        
-        if (!ignore_c && father != nullptr) {
-            ignore_c |= father->ignore_childs();
-        }
-
-        return ignore_c;
-    }
-};
-
-
-int sss_star(state_t n, int color, int boud) {
-    // h value, state * and bool (true is live, false is dead)
-    priority_queue<tuple<int, sss_state*, bool>> pq;
-    vector<sss_state*> to_delete;
-
-    ++generated;
-    sss_state *r = new sss_state(n, nullptr, color);
-    r->root = true;
-    pq.push({INF, r, true});
-
-    int ret = -42;
-
-    while (true) {
-        int h = get<0>(pq.top());
-        sss_state *state = get<1>(pq.top());
-        bool live = get<2>(pq.top());
-        pq.pop();
-
-        // esta es la parte de purgar hijos, la implemente asi: si tu padre purgo a sus hijos,
-        // entonces purgas a los tuyos y no entras de nuevo en la siguiente parte del codigo
-        if (state->father != nullptr && state->father->ignore_childs()){
-            continue;
-        }
-
-        if (live) {
-            if (state->othello.terminal()) {
-                pq.push({min(state->othello.value(), h), state, false});
-            }
-            else if (state->color == -1) {  //min
-                state_t child_othello = state->othello.move(state->color == 1, state->moves.front());
-                state->moves.pop_front();
-
-                sss_state *child = new sss_state(child_othello, state, -state->color);
-                to_delete.push_back(child);
-                pq.push({h, child, true});
-            }
-            else if (state->color == 1) {  //max
-                for (auto move : state->moves) {
-                    state_t child_othello = state->othello.move(state->color == 1, move);
-
-                    sss_state *child = new sss_state(child_othello, state, -state->color);
-                    to_delete.push_back(child);
-                    pq.push({h, child, true});
-                }
-            }
-            ++expanded;
-        }
-        else {
-            if (state->root) {
-                ret = h;
-                break;
-            }
-            else if (state->color == -1) {  //min
-                state->father->ignore_c = true;
-                pq.push({h, state->father, false});
-            }
-            else if (state->color == 1) {  //max
-                if (!state->father->moves.empty()) {
-                    state_t brother_othello = state->father->othello.move(state->father->color == 1, state->father->moves.front());
-                    state->father->moves.pop_front();
-                    sss_state *brother = new sss_state(brother_othello, state->father, -state->father->color);
-                    to_delete.push_back(brother);
-                    pq.push({h, brother, true});
-                }
-                else {
-                    pq.push({h, state->father, false});
-                }
-            }
-        }
-    }
-
-    generated = to_delete.size();
-    for (auto state : to_delete) {
-        delete state;
-    }
-
-    return ret;
-}
-
-
-
-// mtd(f) the better the guess for the f value, the quicker the solution is found
-int mtdf(state_t root, int color, int f) {
-    int bound[2] = { -INF, INF};
-    do {
-        int beta = f + (f == bound[0]);
-        f = negamax(root, beta - 1, beta, color, true);
-        bound[f < beta] = f;
-    } while (bound[0] < bound[1]);
-    return f;
+    return 0;
 }
@@ -0,0 +1,49 @@
+// Game of Othello -- move generator backends
+// Universidad Simon Bolivar, 2012.
+//
+// A backend is a policy class with a static member template
+//
+//     template<bool BLACK> static int generate(const state_t &state, int *moves);
+//
+// that writes the legal moves of the side to move into `moves` (room for
+// DIM entries), in increasing position order, and returns how many there
+// are. The search kernels take the backend as a template parameter, so
+// the choice is resolved at compile time.
+
+#ifndef MOVEGEN_H
+#define MOVEGEN_H
+
+#include "othello_cut.h"
+
+#include <vector>
+
+// Reference backend: the original state_t::get_moves, which scans all DIM
+// positions and returns a freshly allocated vector.
+struct vector_movegen_t {
+    static const char* name() { return "vector"; }
+
+    template<bool BLACK> static int generate(const state_t &state, int *moves) {
+        std::vector<int> valid_moves = state.get_moves(BLACK);
+        for ( int i = 0; i < (int)valid_moves.size(); ++i )
+            moves[i] = valid_moves[i];
+        return valid_moves.size();
+    }
+};
+
+// Visits only the empty squares (the zero bits of free_, which cover
+// positions 4..35; the centre squares are never empty) and writes into
+// the caller's buffer, so no allocation happens per node.
+struct scan_movegen_t {
+    static const char* name() { return "scan"; }
+
+    template<bool BLACK> static int generate(const state_t &state, int *moves) {
+        int n = 0;
+        for ( unsigned empty = ~state.free(); empty != 0; empty &= empty - 1 ) {
+            int pos = 4 + __builtin_ctz(empty);
+            if ( state.outflank(BLACK, pos) ) moves[n++] = pos;
+        }
+        return n;
+    }
+};
+
+#endif
@@ -18,7 +18,11 @@
  *
  */
 
+#ifndef OTHELLO_CUT_H
+#define OTHELLO_CUT_H
+
 #include <cassert>
+#include <cstdint>
 #include <iostream>
 #include <vector>
 #include <stdlib.h>
@@ -97,12 +101,20 @@ class state_t {
 
 public:
     explicit state_t(unsigned char t = 6) : t_(t), free_(0), pos_(0) { }
+    state_t(unsigned char t, unsigned free, unsigned pos) : t_(t), free_(free), pos_(pos) { }
 
     unsigned char t() const { return t_; }
     unsigned free() const { return free_; }
     unsigned pos() const { return pos_; }
     size_t hash() const { return free_ ^ pos_ ^ t_; }
 
+    // Packed 64-bit form: t_ in the low 4 bits, then the non-centre
+    // squares as a base-3 number (square 4+k is digit k: 0 free, 1 white,
+    // 2 black). 3^32 < 2^51, so only the low 55 bits are ever used. Two
+    // positions are equal iff their packed forms are.
+    uint64_t pack() const;
+    static state_t unpack(uint64_t key);
+
     bool is_color(bool color, int pos) const {
         if ( color )
             return pos < 4 ? t_ & (1 << pos) : pos_ & (1 << (pos - 4));
@@ -113,6 +125,7 @@ public:
     bool is_white(int pos) const { return is_color(false, pos); }
     bool is_free(int pos) const { return pos < 4 ? false : !(free_ & (1 << (pos - 4))); }
     bool is_full() const { return ~free_ == 0; }
+    int empties() const { return __builtin_popcount(~free_); }
 
     int value() const;
     bool terminal() const;
@@ -124,7 +137,7 @@ public:
     state_t move(bool color, int pos) const;
     state_t black_move(int pos) { return move(true, pos); }
     state_t white_move(int pos) { return move(false, pos); }
-    int get_random_move(bool color) {
+    int get_random_move(bool color) const {
         std::vector<int> valid_moves;
         for ( int pos = 0; pos < DIM; ++pos ) {
             if ( (color && is_black_move(pos)) || (!color && is_white_move(pos)) ) {
@@ -133,7 +146,7 @@ public:
         }
         return valid_moves.empty() ? -1 : valid_moves[lrand48() % valid_moves.size()];
     }
-    std::vector<int> get_moves(bool color) {
+    std::vector<int> get_moves(bool color) const {
         std::vector<int> valid_moves;
         for ( int pos = 0; pos < DIM; ++pos ) {
             if ( (color && is_black_move(pos)) || (!color && is_white_move(pos)) ) {
@@ -365,8 +378,68 @@ inline void state_t::print_bits(std::ostream &os) const {
     for ( int i = 31; i >= 0; --i ) os << (free_ & (1 << i) ? '1' : '0');
 }
 
+// Base-3 value of a byte of free_ or pos_, and its inverse for the
+// 3^8 = 6561 digits of one byte of squares.
+struct packing_tables_t {
+    unsigned short ternary[256] = { };
+    unsigned char free[6561] = { }, pos[6561] = { };
+    constexpr packing_tables_t() {
+        for ( int b = 0; b < 256; ++b ) {
+            for ( int i = 7; i >= 0; --i ) ternary[b] = 3 * ternary[b] + ((b >> i) & 1);
+        }
+        for ( int d = 0; d < 6561; ++d ) {
+            for ( int i = 0, x = d; i < 8; ++i, x /= 3 ) {
+                if ( x % 3 != 0 ) free[d] |= 1 << i;
+                if ( x % 3 == 2 ) pos[d] |= 1 << i;
+            }
+        }
+    }
+};
+static constexpr packing_tables_t packing_tables;
+
+inline uint64_t state_t::pack() const {
+    // a free square is 0 whatever its bit of pos_ says
+    unsigned pos = pos_ & free_;
+    uint64_t k = 0;
+    for ( int b = 24; b >= 0; b -= 8 )
+        k = k * 6561 + packing_tables.ternary[(free_ >> b) & 0xff] + packing_tables.ternary[(pos >> b) & 0xff];
+    return k << 4 | (t_ & 15);
+}
+
+inline state_t state_t::unpack(uint64_t key) {
+    unsigned char t = key & 15;
+    unsigned free = 0, pos = 0;
+    key >>= 4;
+    for ( int b = 0; b < 32; b += 8 ) {
+        unsigned d = key % 6561;
+        key /= 6561;
+        free |= unsigned(packing_tables.free[d]) << b;
+        pos |= unsigned(packing_tables.pos[d]) << b;
+    }
+    return state_t(t, free, pos);
+}
+
 inline std::ostream& operator<<(std::ostream &os, const state_t &state) {
     state.print(os);
     return os;
 }
 
+// Fills pv[0..npv] with the positions of the principal variation, from
+// the final position (pv[0]) back to the initial one (pv[npv]), and
+// returns npv. pv[i] is to be solved with color 1 (black) when i is odd.
+inline int build_pv(state_t *pv) {
+    int npv = 0;
+    for ( int i = 0; PV[i] != -1; ++i ) ++npv;
+
+    state_t state;
+    for ( int i = 0; PV[i] != -1; ++i ) {
+        bool player = i % 2 == 0; // black moves first!
+        int pos = PV[i];
+        pv[npv - i] = state;
+        state = state.move(player, pos);
+    }
+    pv[0] = state;
+    return npv;
+}
+
+#endif
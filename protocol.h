@@ -0,0 +1,124 @@
+// Game of Othello -- wire format of the analysis server
+// Universidad Simon Bolivar, 2012.
+//
+// Clients send fixed-size requests over a Unix domain socket and may send
+// many before reading any answer (pipelining). The server answers each
+// request with one fixed-size response carrying the same id, in
+// completion order, not request order. Integers are in host byte order:
+// both ends live on the same machine.
+//
+// request (REQUEST_SIZE bytes)        response (RESPONSE_SIZE bytes)
+//    0  uint32  id                       0  uint32  id
+//    4  uint32  state free_              4  uint8   status
+//    8  uint32  state pos_               5  int8    value (side to move)
+//   12  uint8   state t_                 6  int8    best move, -1 if none
+//   13  int8    color to move (1/-1)     7  uint8   PV length
+//   14  uint8   algorithm (as in main)   8  uint64  #generated
+//   15  uint8   flags                   16  float   seconds
+//   16  uint64  max #generated          20  uint8   flags
+//   24  float   max seconds             21  int8[]  PV (DIM is a pass)
+//   28  int16   MTD(f) guess
+//   30  uint16  reserved
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include "othello_cut.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+const int REQUEST_SIZE = 32;
+const int RESPONSE_SIZE = 64;
+const int MAX_WIRE_PV = RESPONSE_SIZE - 21;
+
+// request flags
+const uint8_t REQ_USE_TT = 1;
+const uint8_t REQ_WANT_PV = 2;
+
+// response status and flags; STATUS_ERROR: the search failed (out of
+// memory, spill file), the request itself may be fine
+enum { STATUS_OK, STATUS_ABORTED, STATUS_BAD_REQUEST, STATUS_ERROR };
+const uint8_t RESP_FROM_BOOK = 1;
+const uint8_t RESP_PV_CUT = 2;     // the limits ran out during the PV search
+
+
+struct request_t {
+    uint32_t id = 0;
+    state_t state;
+    int color = 1;
+    int algorithm = 2;
+    uint8_t flags = REQ_USE_TT;
+    uint64_t max_nodes = 0;
+    float max_seconds = 0;
+    int mtdf_guess = 0;
+};
+
+struct response_t {
+    uint32_t id = 0;
+    int status = STATUS_OK;
+    int value = 0;
+    int best_move = -1;
+    std::vector<int> pv;
+    uint64_t generated = 0;
+    float seconds = 0;
+    uint8_t flags = 0;
+};
+
+template<typename T> inline void put(uint8_t *buf, int offset, T x) { memcpy(buf + offset, &x, sizeof(T)); }
+template<typename T> inline T get(const uint8_t *buf, int offset) { T x; memcpy(&x, buf + offset, sizeof(T)); return x; }
+
+inline void encode(const request_t &r, uint8_t *buf) {
+    memset(buf, 0, REQUEST_SIZE);
+    put<uint32_t>(buf, 0, r.id);
+    put<uint32_t>(buf, 4, r.state.free());
+    put<uint32_t>(buf, 8, r.state.pos());
+    put<uint8_t>(buf, 12, r.state.t());
+    put<int8_t>(buf, 13, r.color);
+    put<uint8_t>(buf, 14, r.algorithm);
+    put<uint8_t>(buf, 15, r.flags);
+    put<uint64_t>(buf, 16, r.max_nodes);
+    put<float>(buf, 24, r.max_seconds);
+    put<int16_t>(buf, 28, r.mtdf_guess);
+}
+
+inline void decode(const uint8_t *buf, request_t &r) {
+    r.id = get<uint32_t>(buf, 0);
+    r.state = state_t(get<uint8_t>(buf, 12), get<uint32_t>(buf, 4), get<uint32_t>(buf, 8));
+    r.color = get<int8_t>(buf, 13);
+    r.algorithm = get<uint8_t>(buf, 14);
+    r.flags = get<uint8_t>(buf, 15);
+    r.max_nodes = get<uint64_t>(buf, 16);
+    r.max_seconds = get<float>(buf, 24);
+    r.mtdf_guess = get<int16_t>(buf, 28);
+}
+
+inline void encode(const response_t &r, uint8_t *buf) {
+    memset(buf, 0, RESPONSE_SIZE);
+    int npv = r.pv.size() < size_t(MAX_WIRE_PV) ? r.pv.size() : MAX_WIRE_PV;
+    put<uint32_t>(buf, 0, r.id);
+    put<uint8_t>(buf, 4, r.status);
+    put<int8_t>(buf, 5, r.value);
+    put<int8_t>(buf, 6, r.best_move);
+    put<uint8_t>(buf, 7, npv);
+    put<uint64_t>(buf, 8, r.generated);
+    put<float>(buf, 16, r.seconds);
+    put<uint8_t>(buf, 20, r.flags);
+    for ( int i = 0; i < npv; ++i ) put<int8_t>(buf, 21 + i, r.pv[i]);
+}
+
+inline void decode(const uint8_t *buf, response_t &r) {
+    r.id = get<uint32_t>(buf, 0);
+    r.status = get<uint8_t>(buf, 4);
+    r.value = get<int8_t>(buf, 5);
+    r.best_move = get<int8_t>(buf, 6);
+    int npv = get<uint8_t>(buf, 7);
+    r.generated = get<uint64_t>(buf, 8);
+    r.seconds = get<float>(buf, 16);
+    r.flags = get<uint8_t>(buf, 20);
+    r.pv.clear();
+    for ( int i = 0; i < npv && i < MAX_WIRE_PV; ++i ) r.pv.push_back(get<int8_t>(buf, 21 + i));
+}
+
+#endif
@@ -0,0 +1,463 @@
+// Game of Othello -- reusable searcher
+// Universidad Simon Bolivar, 2012.
+//
+// Every kernel is a template on the side to move (COLOR, 1 for black and
+// -1 for white) and on the move generator backend (MG, see movegen.h);
+// negamax also takes USE_TT and test takes the comparison (GE). Each
+// instantiation therefore has no runtime checks for any of them, and
+// recursion flips COLOR through the template argument. solve() is the
+// single runtime dispatch point, used at the root.
+//
+// bench measured the specialisation on COLOR, USE_TT and GE alone as
+// neutral (about 1.0x against runtime-flag kernels on the same backend);
+// the per-node speedup comes from scan_movegen_t.
+
+#include "searcher.h"
+#include "movegen.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <climits>
+#include <stdexcept>
+
+Searcher::Searcher(const searcher_options_t &options) : options_(options) {
+    for ( int c = 0; c < 2; ++c ) {
+        tt_[c].configure(options.tt_bytes,
+                         options.spill_path.empty() ? "" : options.spill_path + "." + std::to_string(c),
+                         options.spill_bytes);
+    }
+}
+
+Searcher::~Searcher() {
+}
+
+void Searcher::clear() {
+    tt_[0].clear();
+    tt_[1].clear();
+}
+
+void Searcher::reserve() {
+    tt_[0].reserve();
+    tt_[1].reserve();
+}
+
+search_result_t Searcher::solve(const state_t &state, int color, int algorithm, const search_limits_t &limits) {
+    if ( algorithm < MINMAX || algorithm > MTDF )
+        throw std::invalid_argument("unknown algorithm " + std::to_string(algorithm));
+    if ( options_.movegen == MOVEGEN_VECTOR )
+        return run<vector_movegen_t>(state, color, algorithm, limits);
+    return run<scan_movegen_t>(state, color, algorithm, limits);
+}
+
+void Searcher::check_limits() {
+    if ( max_nodes_ != 0 && generated_ >= max_nodes_ ) throw aborted_t();
+    if ( deadline_ != 0 && Utils::read_thread_time_in_seconds() >= deadline_ ) throw aborted_t();
+
+    // look again in a while: reading the clock is a system call
+    next_check_ = ULLONG_MAX;
+    if ( deadline_ != 0 ) next_check_ = generated_ + (1 << 16);
+    if ( max_nodes_ != 0 ) next_check_ = std::min(next_check_, max_nodes_);
+}
+
+template<class MG>
+search_result_t Searcher::run(const state_t &state, int color, int algorithm, const search_limits_t &limits) {
+    search_result_t result;
+    size_t spilled = tt_[0].spilled() + tt_[1].spilled();
+    size_t spill_hits = tt_[0].spill_hits() + tt_[1].spill_hits();
+    for ( int c = 0; c < 2; ++c ) tt_[c].spill_min_empties = state.empties() - options_.spill_plies;
+    float start_time = Utils::read_thread_time_in_seconds();
+    expanded_ = 0;
+    generated_ = 0;
+    next_check_ = 0;
+    max_nodes_ = limits.max_nodes;
+    deadline_ = limits.max_seconds > 0 ? start_time + limits.max_seconds : 0;
+
+    try {
+        result.value = color == 1 ? run<1, MG>(state, algorithm, limits) : run<-1, MG>(state, algorithm, limits);
+        result.complete = true;
+    } catch ( const aborted_t & ) {
+    }
+
+    result.stats.expanded = expanded_;
+    result.stats.generated = generated_;
+    result.stats.seconds = Utils::read_thread_time_in_seconds() - start_time;
+    result.stats.tt_entries = tt_[0].size() + tt_[1].size();
+    result.stats.spilled = tt_[0].spilled() + tt_[1].spilled() - spilled;
+    result.stats.spill_hits = tt_[0].spill_hits() + tt_[1].spill_hits() - spill_hits;
+
+    if ( result.complete && (algorithm == ALPHABETA || algorithm == NEGASCOUT) ) {
+        if ( result.value <= limits.alpha ) result.type = UPPER;
+        else if ( result.value >= limits.beta ) result.type = LOWER;
+    }
+    if ( result.complete && result.type == EXACT && limits.want_pv ) {
+        // the PV search runs under what is left of the same limits
+        try {
+            if ( color == 1 )
+                extract_pv<1, MG>(state, result.value, result);
+            else
+                extract_pv<-1, MG>(state, result.value, result);
+            result.pv_complete = true;
+        } catch ( const aborted_t & ) {
+        }
+        if ( !result.pv.empty() ) result.best_move = result.pv[0];
+    }
+    return result;
+}
+
+template<int COLOR, class MG>
+int Searcher::run(const state_t &state, int algorithm, const search_limits_t &limits) {
+    if ( algorithm == MINMAX )
+        return negamax<COLOR, MG>(state);
+    else if ( algorithm == ALPHABETA && limits.use_tt )
+        return negamax<COLOR, true, MG>(state, state.pack(), limits.alpha, limits.beta);
+    else if ( algorithm == ALPHABETA )
+        return negamax<COLOR, false, MG>(state, 0, limits.alpha, limits.beta);
+    else if ( algorithm == SCOUT )
+        return COLOR * scout<COLOR, MG>(state);
+    else if ( algorithm == NEGASCOUT )
+        return negascout<COLOR, MG>(state, limits.alpha, limits.beta);
+    else if ( algorithm == SSS_STAR )
+        return COLOR * sss_star<MG>(state, COLOR, INF);
+    else
+        return mtdf<COLOR, MG>(state, limits.mtdf_guess);
+}
+
+// Follows, from state, children whose value is the negation of their
+// parent's, proving each with a null-window search on the TT.
+template<int COLOR, class MG>
+void Searcher::extract_pv(state_t state, int value, search_result_t &result) {
+    if ( state.terminal() ) return;
+
+    int moves[DIM];
+    int nmoves = MG::template generate<COLOR == 1>(state, moves);
+    if ( nmoves == 0 ) {
+        result.pv.push_back(DIM);
+        extract_pv<-COLOR, MG>(state, -value, result);
+        return;
+    }
+    for ( int i = 0; i < nmoves; ++i ) {
+        state_t child = state.move(COLOR == 1, moves[i]);
+        if ( negamax<-COLOR, true, MG>(child, child.pack(), -value - 1, -value + 1) == -value ) {
+            result.pv.push_back(moves[i]);
+            extract_pv<-COLOR, MG>(child, -value, result);
+            return;
+        }
+    }
+}
+
+template<int COLOR, class MG>
+int Searcher::negamax(const state_t &state) {
+    count_node();
+    if (state.terminal())
+        return COLOR * state.value();
+
+    int score = -INF;
+    int moves[DIM];
+    int nmoves = MG::template generate<COLOR == 1>(state, moves);
+    for (int i = 0; i < nmoves; ++i) {
+        score = std::max(
+                    score,
+                    -negamax<-COLOR, MG>(state.move(COLOR == 1, moves[i]))
+                );
+    }
+    // si no logre moverme sigo en el mismo estado pero cambio el color
+    if (nmoves == 0)
+        score = -negamax<-COLOR, MG>(state);
+
+    ++expanded_;
+    return score;
+}
+
+// key es state.pack() con TT (cada hijo se empaca una sola vez, en el padre)
+template<int COLOR, bool USE_TT, class MG>
+int Searcher::negamax(const state_t &state, uint64_t key, int alpha, int beta) {
+    unsigned long long first_generated = generated_;
+    count_node();
+    int original_alpha = alpha;
+    ttable_t &tt = tt_[COLOR == 1];
+
+    ttable_t::slot_t slot;
+    stored_info_t tup;
+    if (USE_TT && tt.probe(state, key, slot, tup)) {
+        if (tup.type_ == EXACT) {
+            return tup.value_;
+        }
+        else if (tup.type_ == UPPER) {
+            beta = std::min(beta, tup.value_);
+        }
+        else if (tup.type_ == LOWER) {
+            alpha = std::max(alpha, tup.value_);
+        }
+
+        if (alpha >= beta)
+            return tup.value_;
+    }
+
+    if (state.terminal())
+        return COLOR * state.value();
+
+    int score = -INF;
+    int moves[DIM];
+    int nmoves = MG::template generate<COLOR == 1>(state, moves);
+    // con TT, generar todos los hijos de una vez y pedir sus buckets a la
+    // cache mientras se recorre el primero
+    state_t childs[USE_TT ? DIM : 1];
+    uint64_t keys[USE_TT ? DIM : 1];
+    if (USE_TT) {
+        for (int i = 0; i < nmoves; ++i) {
+            childs[i] = state.move(COLOR == 1, moves[i]);
+            keys[i] = childs[i].pack();
+            tt_[COLOR != 1].prefetch(keys[i]);
+        }
+        // cerca de la raiz, pedir de una vez al disco las entradas de todos los hijos
+        if (tt_[COLOR != 1].probes_spill(state.empties() - 1)) {
+            for (int i = 0; i < nmoves; ++i)
+                tt_[COLOR != 1].prefetch_spill(keys[i]);
+        }
+    }
+    for (int i = 0; i < nmoves; ++i) {
+        score = std::max(
+                    score,
+                    -negamax<-COLOR, USE_TT, MG>(USE_TT ? childs[i] : state.move(COLOR == 1, moves[i]), USE_TT ? keys[i] : 0, -beta, -alpha)
+                );
+        alpha = std::max(alpha, score);
+        if (alpha >= beta)
+            break;
+    }
+    // si no logre moverme sigo en el mismo estado pero cambio el color
+    if (nmoves == 0)
+        score = -negamax<-COLOR, USE_TT, MG>(state, key, -beta, -alpha);
+
+    if (USE_TT) {
+        tup = {score, EXACT};
+        if (score <= original_alpha)
+            tup.type_ = UPPER;
+        else if (score >= beta)
+            tup.type_ = LOWER;
+        tt.store(slot, tup, generated_ - first_generated);
+    }
+
+    ++expanded_;
+    return score;
+}
+
+// GE : false es > ; true es >=
+template<int COLOR, bool GE, class MG>
+bool Searcher::test(const state_t &state, int score) {
+    count_node();
+    if (state.terminal())
+        return GE ? state.value() >= score : state.value() > score;
+
+    ++expanded_;
+    int moves[DIM];
+    int nmoves = MG::template generate<COLOR == 1>(state, moves);
+    for (int i = 0; i < nmoves; ++i) {
+        auto child = state.move(COLOR == 1, moves[i]);
+        if constexpr (COLOR == 1) {
+            if (test<-COLOR, GE, MG>(child, score))
+                return true;
+        } else {
+            if (!test<-COLOR, GE, MG>(child, score))
+                return false;
+        }
+    }
+
+    if (nmoves == 0) {
+        if constexpr (COLOR == 1) {
+            if (test<-COLOR, GE, MG>(state, score))
+                return true;
+        } else {
+            if (!test<-COLOR, GE, MG>(state, score))
+                return false;
+        }
+    }
+
+    return COLOR == -1;
+}
+
+template<int COLOR, class MG>
+int Searcher::scout(const state_t &state) {
+    count_node();
+    if (state.terminal())
+        return state.value();
+
+    int score = 0;
+    int moves[DIM];
+    int nmoves = MG::template generate<COLOR == 1>(state, moves);
+    for (int i = 0; i < nmoves; ++i) {
+        auto child = state.move(COLOR == 1, moves[i]);
+        // primer hijo
+        if (i == 0)
+            score = scout<-COLOR, MG>(child);
+        else if constexpr (COLOR == 1) {
+            if (test<-COLOR, false, MG>(child, score))
+                score = scout<-COLOR, MG>(child);
+        } else {
+            if (!test<-COLOR, true, MG>(child, score))
+                score = scout<-COLOR, MG>(child);
+        }
+    }
+    // no se logro poner fichas, pasar turno
+    if (nmoves == 0)
+        score = scout<-COLOR, MG>(state);
+
+    ++expanded_;
+    return score;
+}
+
+template<int COLOR, class MG>
+int Searcher::negascout(const state_t &state, int alpha, int beta) {
+    count_node();
+    if (state.terminal())
+        return COLOR * state.value();
+
+    int score;
+    int moves[DIM];
+    int nmoves = MG::template generate<COLOR == 1>(state, moves);
+    for (int i = 0; i < nmoves; ++i) {
+        auto child = state.move(COLOR == 1, moves[i]);
+        // primer hijo
+        if (i == 0)
+            score = -negascout<-COLOR, MG>(child, -beta, -alpha);
+        else {
+            score = -negascout<-COLOR, MG>(child, -alpha - 1, -alpha);
+            if (alpha < score && score < beta)
+                score = -negascout<-COLOR, MG>(child, -beta, -score);
+        }
+
+        alpha = std::max(alpha, score);
+        if (alpha >= beta)
+            break;
+    }
+
+    // no se logro poner fichas, pasar turno
+    if (nmoves == 0)
+        alpha = -negascout<-COLOR, MG>(state, -beta, -alpha);
+
+    ++expanded_;
+    return alpha;
+}
+
+// SSS*
+// MAX and MIN nodes share the OPEN list, so the node colour stays a
+// runtime field here; only the move generator is a template parameter.
+// A node's moves are moves[next..nmoves); a pass is stored as DIM.
+bool Searcher::sss_node_t::ignore_childs() {
+    if (!ignore_c && father != nullptr) {
+        ignore_c |= father->ignore_childs();
+    }
+
+    return ignore_c;
+}
+
+template<class MG>
+Searcher::sss_node_t* Searcher::sss_new_node(const state_t &othello, sss_node_t *father, int color) {
+    count_node();
+    if ( arena_used_ == arena_.size() * ARENA_CHUNK )
+        arena_.emplace_back(new sss_node_t[ARENA_CHUNK]);
+    sss_node_t *node = &arena_[arena_used_ / ARENA_CHUNK][arena_used_ % ARENA_CHUNK];
+    ++arena_used_;
+
+    node->othello = othello.pack();
+    node->father = father;
+    node->color = color;
+    node->root = false;
+    node->ignore_c = false;
+
+    int moves[DIM];
+    int nmoves = color == 1 ? MG::template generate<true>(othello, moves)
+                            : MG::template generate<false>(othello, moves);
+    for (int i = 0; i < nmoves; ++i)
+        node->moves[i] = moves[i];
+    if (nmoves == 0)
+        node->moves[nmoves++] = DIM;
+    node->nmoves = nmoves;
+    node->next = 0;
+    return node;
+}
+
+template<class MG>
+int Searcher::sss_star(const state_t &n, int color, int boud) {
+    // h value, state * and bool (true is live, false is dead); open_ is a max-heap
+    arena_used_ = 0;
+    open_.clear();
+    auto push = [this](int h, sss_node_t *state, bool live) {
+        open_.emplace_back(h, state, live);
+        std::push_heap(open_.begin(), open_.end());
+    };
+
+    sss_node_t *r = sss_new_node<MG>(n, nullptr, color);
+    r->root = true;
+    push(INF, r, true);
+
+    int ret = -42;
+
+    while (true) {
+        std::pop_heap(open_.begin(), open_.end());
+        int h = std::get<0>(open_.back());
+        sss_node_t *state = std::get<1>(open_.back());
+        bool live = std::get<2>(open_.back());
+        open_.pop_back();
+
+        // esta es la parte de purgar hijos, la implemente asi: si tu padre purgo a sus hijos,
+        // entonces purgas a los tuyos y no entras de nuevo en la siguiente parte del codigo
+        if (state->father != nullptr && state->father->ignore_childs()){
+            continue;
+        }
+
+        if (live) {
+            state_t othello = state_t::unpack(state->othello);
+            if (othello.terminal()) {
+                push(std::min(othello.value(), h), state, false);
+            }
+            else if (state->color == -1) {  //min
+                state_t child_othello = othello.move(state->color == 1, state->moves[state->next++]);
+                push(h, sss_new_node<MG>(child_othello, state, -state->color), true);
+            }
+            else if (state->color == 1) {  //max
+                for (int i = state->next; i < state->nmoves; ++i) {
+                    state_t child_othello = othello.move(state->color == 1, state->moves[i]);
+                    push(h, sss_new_node<MG>(child_othello, state, -state->color), true);
+                }
+            }
+            ++expanded_;
+        }
+        else {
+            if (state->root) {
+                ret = h;
+                break;
+            }
+            else if (state->color == -1) {  //min
+                state->father->ignore_c = true;
+                push(h, state->father, false);
+            }
+            else if (state->color == 1) {  //max
+                sss_node_t *father = state->father;
+                if (father->next < father->nmoves) {
+                    state_t brother_othello = state_t::unpack(father->othello).move(father->color == 1, father->moves[father->next++]);
+                    push(h, sss_new_node<MG>(brother_othello, father, -father->color), true);
+                }
+                else {
+                    push(h, father, false);
+                }
+            }
+        }
+    }
+
+    // como antes, se cuentan los nodos creados sin la raiz
+    generated_ = arena_used_ - 1;
+    return ret;
+}
+
+// mtd(f) the better the guess for the f value, the quicker the solution is found
+template<int COLOR, class MG>
+int Searcher::mtdf(const state_t &root, int f) {
+    int bound[2] = { -INF, INF};
+    uint64_t key = root.pack();
+    do {
+        int beta = f + (f == bound[0]);
+        f = negamax<COLOR, true, MG>(root, key, beta - 1, beta);
+        bound[f < beta] = f;
+    } while (bound[0] < bound[1]);
+    return f;
+}
@@ -0,0 +1,140 @@
+// Game of Othello -- reusable searcher
+// Universidad Simon Bolivar, 2012.
+//
+// A Searcher owns everything a search needs: the transposition tables,
+// the SSS* node arena and OPEN list, and the node counters. Nothing is
+// global, so several searchers can live in one process, and nothing is
+// released between calls to solve(), so a searcher answering many
+// queries reuses its memory and keeps its TT warm (call clear() to start
+// cold).
+
+#ifndef SEARCHER_H
+#define SEARCHER_H
+
+#include "othello_cut.h"
+#include "ttable.h"
+
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+const int INF = 200;
+
+// algorithms, numbered as in main
+enum algorithm_t {
+    MINMAX = 1,      // negamax without pruning
+    ALPHABETA = 2,   // negamax with alpha-beta pruning
+    SCOUT = 3,
+    NEGASCOUT = 4,
+    SSS_STAR = 5,
+    MTDF = 6
+};
+
+enum movegen_t { MOVEGEN_SCAN, MOVEGEN_VECTOR };
+
+struct searcher_options_t {
+    size_t tt_bytes = size_t(256) << 20;   // RAM for each of the two TTs
+    std::string spill_path;                // second TT level in spill_path.0/.1
+    size_t spill_bytes = size_t(4096) << 20;
+    int spill_plies = 12;                  // nodes this close to the root use the file
+    movegen_t movegen = MOVEGEN_SCAN;      // see movegen.h
+};
+
+// Limits and knobs of one query.
+struct search_limits_t {
+    unsigned long long max_nodes = 0;   // 0 = no limit
+    float max_seconds = 0;              // CPU time of the thread, 0 = no limit
+    bool use_tt = false;                // for ALPHABETA (MTDF always uses it)
+    int mtdf_guess = 0;
+    int alpha = -INF, beta = INF;       // window for ALPHABETA and NEGASCOUT
+    bool want_pv = true;
+};
+
+struct search_stats_t {
+    unsigned long long expanded = 0;
+    unsigned long long generated = 0;
+    float seconds = 0;
+    size_t tt_entries = 0;
+    size_t spilled = 0;
+    size_t spill_hits = 0;
+};
+
+struct search_result_t {
+    bool complete = false;     // false if a limit stopped the search
+    int value = 0;             // from the point of view of the side to move
+    int type = EXACT;          // LOWER/UPPER if value fell outside the window
+    int best_move = -1;        // DIM for a pass, -1 if unknown or terminal
+    std::vector<int> pv;       // moves from the position, DIM for passes
+    bool pv_complete = false;  // pv reaches the end of the game; false if a limit cut it
+    search_stats_t stats;      // of the search proper, without the PV extraction
+};
+
+class Searcher {
+  public:
+    explicit Searcher(const searcher_options_t &options = searcher_options_t());
+    ~Searcher();
+    Searcher(const Searcher &) = delete;
+    Searcher& operator=(const Searcher &) = delete;
+
+    // Solves state with color (1 black, -1 white) to move.
+    search_result_t solve(const state_t &state, int color, int algorithm,
+                          const search_limits_t &limits = search_limits_t());
+
+    // Forgets everything stored in the transposition tables.
+    void clear();
+    // Allocates and touches the transposition tables up front.
+    void reserve();
+
+    const ttable_t& tt(int color) const { return tt_[color == 1]; }
+    const searcher_options_t& options() const { return options_; }
+
+  private:
+    struct aborted_t { };
+    // one cache line per node
+    struct alignas(64) sss_node_t {
+        uint64_t othello;       // state_t::pack()
+        sss_node_t *father;
+        signed char color;
+        bool root;
+        bool ignore_c;
+        unsigned char nmoves, next;
+        unsigned char moves[DIM];
+
+        bool ignore_childs();
+    };
+    static_assert(sizeof(sss_node_t) == 64, "an SSS* node must fill one cache line");
+    typedef std::tuple<int, sss_node_t*, bool> sss_entry_t;
+    static const int ARENA_CHUNK = 1 << 14;
+
+    searcher_options_t options_;
+    ttable_t tt_[2];
+    unsigned long long expanded_ = 0;
+    unsigned long long generated_ = 0;
+    unsigned long long next_check_ = 0;
+    unsigned long long max_nodes_ = 0;
+    float deadline_ = 0;
+
+    // SSS*: nodes are carved out of chunks that are kept between calls
+    std::vector<std::unique_ptr<sss_node_t[]>> arena_;
+    size_t arena_used_ = 0;
+    std::vector<sss_entry_t> open_;
+
+    void count_node() { if ( ++generated_ >= next_check_ ) check_limits(); }
+    void check_limits();
+
+    template<class MG> search_result_t run(const state_t &state, int color, int algorithm, const search_limits_t &limits);
+    template<int COLOR, class MG> int run(const state_t &state, int algorithm, const search_limits_t &limits);
+    template<int COLOR, class MG> void extract_pv(state_t state, int value, search_result_t &result);
+
+    template<int COLOR, class MG> int negamax(const state_t &state);
+    template<int COLOR, bool USE_TT, class MG> int negamax(const state_t &state, uint64_t key, int alpha, int beta);
+    template<int COLOR, bool GE, class MG> bool test(const state_t &state, int score);
+    template<int COLOR, class MG> int scout(const state_t &state);
+    template<int COLOR, class MG> int negascout(const state_t &state, int alpha, int beta);
+    template<class MG> sss_node_t* sss_new_node(const state_t &othello, sss_node_t *father, int color);
+    template<class MG> int sss_star(const state_t &n, int color, int bound);
+    template<int COLOR, class MG> int mtdf(const state_t &root, int f);
+};
+
+#endif
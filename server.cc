@@ -0,0 +1,310 @@
+// Game of Othello -- resident analysis server
+// Universidad Simon Bolivar, 2012.
+//
+// Usage: server [-t threads] [-m MB] [-w steps] [-n nodes] [-T seconds] socket-path
+//   -t  worker threads (default: number of CPUs)
+//   -m  RAM for each transposition table of each worker (default 64)
+//   -w  solve the last <steps> PV positions into the book at startup
+//   -n  #generated limit of requests that set no limit (default 20000000)
+//   -T  CPU seconds limit of requests that set no limit (default 0 = none)
+//
+// Answers position queries (see protocol.h) over a Unix domain socket.
+// Every worker owns a Searcher whose tables are allocated and touched at
+// startup and stay warm between queries. Exact answers also go into a
+// book shared by all workers and consulted before queueing, so repeated
+// positions are answered by the connection's reader without any search.
+//
+// Each connection has a reader thread that decodes the pipelined
+// requests as they arrive and puts them in one queue. Workers take them
+// in batches. A request identical to one already queued or being solved
+// is attached to it instead of being solved twice. A search that throws
+// (e.g. out of memory) is answered with STATUS_ERROR and the worker goes
+// on with the next job.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <unordered_map>
+#include <cmath>
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "othello_cut.h"
+#include "searcher.h"
+#include "protocol.h"
+
+using namespace std;
+
+struct connection_t {
+    int fd;
+    mutex write_mutex;
+
+    explicit connection_t(int fd) : fd(fd) { }
+    ~connection_t() { close(fd); }
+
+    void send_response(const response_t &r) {
+        uint8_t buf[RESPONSE_SIZE];
+        encode(r, buf);
+        lock_guard<mutex> lock(write_mutex);
+        for ( size_t sent = 0; sent < sizeof(buf); ) {
+            ssize_t n = send(fd, buf + sent, sizeof(buf) - sent, MSG_NOSIGNAL);
+            if ( n < 0 && errno == EINTR ) continue;
+            if ( n <= 0 ) return; // client went away
+            sent += n;
+        }
+    }
+};
+
+struct waiter_t {
+    shared_ptr<connection_t> connection;
+    uint32_t id;
+};
+
+struct job_t {
+    request_t request;
+    string key;
+    vector<waiter_t> waiters;
+};
+
+struct book_entry_t {
+    int value;
+    bool has_pv;
+    vector<int> pv;
+};
+
+const size_t MAX_BATCH = 16;
+const size_t MAX_BOOK = size_t(1) << 22;
+
+searcher_options_t options;
+int nworkers = 1;
+unsigned long long default_nodes = 20000000;
+float default_seconds = 0;
+
+mutex queue_mutex;            // guards queue, inflight and book
+condition_variable queue_ready;
+deque<shared_ptr<job_t>> queue;
+unordered_map<string, shared_ptr<job_t>> inflight;  // queued or being solved
+unordered_map<string, book_entry_t> book;
+
+// book key: the position and the side to move
+string book_key(const request_t &r) {
+    uint8_t buf[REQUEST_SIZE];
+    encode(r, buf);
+    return string(reinterpret_cast<char*>(buf) + 4, 10);
+}
+
+// job key: everything in the request but its id
+string job_key(const uint8_t *buf) {
+    return string(reinterpret_cast<const char*>(buf) + 4, REQUEST_SIZE - 4);
+}
+
+response_t solve(Searcher &searcher, const request_t &request) {
+    search_limits_t limits;
+    limits.use_tt = request.flags & REQ_USE_TT;
+    limits.want_pv = request.flags & REQ_WANT_PV;
+    limits.max_nodes = request.max_nodes;
+    limits.max_seconds = request.max_seconds;
+    limits.mtdf_guess = request.mtdf_guess;
+    response_t response;
+    search_result_t result;
+    try {
+        result = searcher.solve(request.state, request.color, request.algorithm, limits);
+    } catch ( const exception &e ) {
+        cerr << "error: " << e.what() << endl;
+        response.status = STATUS_ERROR;
+        return response;
+    }
+
+    response.status = result.complete ? STATUS_OK : STATUS_ABORTED;
+    response.value = result.value;
+    response.best_move = result.best_move;
+    response.pv = result.pv;
+    if ( limits.want_pv && result.complete && !result.pv_complete ) response.flags |= RESP_PV_CUT;
+    response.generated = result.stats.generated;
+    response.seconds = result.stats.seconds;
+    return response;
+}
+
+void worker() {
+    Searcher searcher(options);
+    try {
+        searcher.reserve();
+    } catch ( const exception &e ) {
+        cerr << "warning: cannot reserve the tables: " << e.what() << endl;
+    }
+
+    vector<shared_ptr<job_t>> batch;
+    while ( true ) {
+        {
+            unique_lock<mutex> lock(queue_mutex);
+            queue_ready.wait(lock, [] { return !queue.empty(); });
+            // leave work for the other workers when the queue is short
+            size_t n = min(MAX_BATCH, max<size_t>(1, queue.size() / nworkers));
+            while ( batch.size() < n ) {
+                batch.push_back(queue.front());
+                queue.pop_front();
+            }
+        }
+
+        for ( auto &job : batch ) {
+            response_t response = solve(searcher, job->request);
+            vector<waiter_t> waiters;
+            {
+                lock_guard<mutex> lock(queue_mutex);
+                if ( response.status == STATUS_OK && book.size() < MAX_BOOK ) {
+                    book_entry_t &entry = book[book_key(job->request)];
+                    // a cut PV is not worth keeping, the value still is
+                    bool has_pv = (job->request.flags & REQ_WANT_PV) && !(response.flags & RESP_PV_CUT);
+                    if ( !entry.has_pv ) entry = { response.value, has_pv, has_pv ? response.pv : vector<int>() };
+                }
+                inflight.erase(job->key);
+                waiters.swap(job->waiters);
+            }
+            for ( auto &w : waiters ) {
+                response.id = w.id;
+                w.connection->send_response(response);
+            }
+        }
+        batch.clear();
+    }
+}
+
+// Answers from the book, attaches to an identical job, or queues a new one.
+void handle(const shared_ptr<connection_t> &connection, const uint8_t *buf) {
+    request_t request;
+    decode(buf, request);
+    response_t response;
+    response.id = request.id;
+
+    if ( request.algorithm < MINMAX || request.algorithm > MTDF || (request.color != 1 && request.color != -1) ) {
+        response.status = STATUS_BAD_REQUEST;
+        connection->send_response(response);
+        return;
+    }
+
+    // nobody gets to keep a worker busy forever; the job key is the
+    // request with the limits actually used
+    uint8_t capped[REQUEST_SIZE];
+    // seconds that are not a positive number (negative, NaN, infinite)
+    // mean no deadline to the searcher: unset
+    if ( !(request.max_seconds > 0 && isfinite(request.max_seconds)) ) request.max_seconds = 0;
+    if ( request.max_nodes == 0 && request.max_seconds == 0 ) {
+        request.max_nodes = default_nodes;
+        request.max_seconds = default_seconds;
+    }
+    encode(request, capped);
+
+    unique_lock<mutex> lock(queue_mutex);
+    auto b = book.find(book_key(request));
+    if ( b != book.end() && (b->second.has_pv || !(request.flags & REQ_WANT_PV)) ) {
+        response.value = b->second.value;
+        if ( request.flags & REQ_WANT_PV ) response.pv = b->second.pv;
+        if ( !response.pv.empty() ) response.best_move = response.pv[0];
+        response.flags = RESP_FROM_BOOK;
+        lock.unlock();
+        connection->send_response(response);
+        return;
+    }
+
+    string key = job_key(capped);
+    auto j = inflight.find(key);
+    if ( j != inflight.end() ) {
+        j->second->waiters.push_back({ connection, request.id });
+        return;
+    }
+    auto job = make_shared<job_t>();
+    job->request = request;
+    job->key = key;
+    job->waiters.push_back({ connection, request.id });
+    inflight[key] = job;
+    queue.push_back(job);
+    queue_ready.notify_one();
+}
+
+void reader(shared_ptr<connection_t> connection) {
+    uint8_t buf[REQUEST_SIZE * 64];
+    size_t have = 0;
+    while ( true ) {
+        ssize_t n = read(connection->fd, buf + have, sizeof(buf) - have);
+        if ( n < 0 && errno == EINTR ) continue;
+        if ( n <= 0 ) break;
+        have += n;
+
+        size_t offset = 0;
+        for ( ; have - offset >= size_t(REQUEST_SIZE); offset += REQUEST_SIZE )
+            handle(connection, buf + offset);
+        memmove(buf, buf + offset, have - offset);
+        have -= offset;
+    }
+    // the socket is closed when the last pending answer is sent
+}
+
+int main(int argc, char **argv) {
+    options.tt_bytes = size_t(64) << 20;
+    nworkers = max(1u, thread::hardware_concurrency());
+    int warm_steps = 0;
+    int opt;
+    while ( (opt = getopt(argc, argv, "t:m:w:n:T:")) != -1 ) {
+        if ( opt == 't' ) nworkers = max(1, atoi(optarg));
+        else if ( opt == 'm' ) options.tt_bytes = size_t(atol(optarg)) << 20;
+        else if ( opt == 'w' ) warm_steps = atoi(optarg);
+        else if ( opt == 'n' ) default_nodes = strtoull(optarg, nullptr, 10);
+        else if ( opt == 'T' ) default_seconds = atof(optarg);
+        else return 1;
+    }
+    if ( optind + 1 != argc ) {
+        cerr << "usage: server [-t threads] [-m MB] [-w steps] [-n nodes] [-T seconds] socket-path" << endl;
+        return 1;
+    }
+    const char *path = argv[optind];
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if ( strlen(path) >= sizeof(addr.sun_path) ) {
+        cerr << "error: socket path too long" << endl;
+        return 1;
+    }
+    strcpy(addr.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path);
+    if ( fd < 0 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 128) != 0 ) {
+        cerr << "error: cannot listen on " << path << ": " << strerror(errno) << endl;
+        return 1;
+    }
+
+    // warm-up jobs have nobody waiting for them; they only fill the book
+    state_t pv[128];
+    int npv = build_pv(pv);
+    for ( int i = 0; i < warm_steps && i <= npv; ++i ) {
+        auto job = make_shared<job_t>();
+        job->request.state = pv[i];
+        job->request.color = i % 2 == 1 ? 1 : -1;
+        job->request.flags = REQ_USE_TT | REQ_WANT_PV;
+        uint8_t buf[REQUEST_SIZE];
+        encode(job->request, buf);
+        job->key = job_key(buf);
+        inflight[job->key] = job;
+        queue.push_back(job);
+    }
+
+    for ( int i = 0; i < nworkers; ++i ) thread(worker).detach();
+    cout << "Listening on " << path << " with " << nworkers << " workers" << endl;
+
+    while ( true ) {
+        int client = accept(fd, nullptr, nullptr);
+        if ( client < 0 ) {
+            if ( errno == EINTR || errno == ECONNABORTED ) continue;
+            cerr << "error: accept: " << strerror(errno) << endl;
+            return 1;
+        }
+        thread(reader, make_shared<connection_t>(client)).detach();
+    }
+}
@@ -0,0 +1,352 @@
+// Game of Othello -- two-level transposition table
+// Universidad Simon Bolivar, 2012.
+//
+// The first level is a fixed-size table in RAM made of WAYS-entry
+// buckets, one cache line each. A reserved table lives on huge pages when
+// the system has them (see allocate), so a probe costs one cache miss and
+// rarely a TLB miss; a table allocated lazily by the first probe keeps
+// normal pages, since faulting in (and zeroing) a whole 2MB page on the
+// first touch of each random bucket costs far more than it saves.
+// Entries are keyed by the packed position (state_t::pack), 16 bytes
+// each. A node probes its bucket once (probe) and later stores into the
+// same slot; the searcher prefetches the buckets of a node's children while
+// it is still working on the node. When a bucket is full the entry with
+// the smallest subtree (the number of nodes generated below it) is
+// evicted. Evicted entries whose subtree is large go to the second level,
+// a hash table of the same buckets stored in a file and mapped with mmap,
+// so positions that took long to solve survive even when RAM is scarce.
+//
+// Disk latency is kept off the critical path in two ways: only positions
+// with at least spill_min_empties empty squares (i.e. near the root; the
+// searcher sets it from the root of each search) ever probe the file,
+// and the searcher asks for the file pages of all the children of such a
+// node at once (prefetch_spill, an asynchronous madvise) before recursing
+// into the first one. Only those positions are written to the file too,
+// so everything spilled can be read back. Evictions are buffered, found
+// by probe while buffered, and written to the file in batches and by
+// clear().
+//
+// clear() bumps a generation counter instead of wiping memory; entries
+// from older generations read as empty.
+
+#ifndef TTABLE_H
+#define TTABLE_H
+
+#include "othello_cut.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+enum { EXACT, LOWER, UPPER };
+struct stored_info_t {
+    int value_;
+    int type_;
+    stored_info_t(int value = -100, int type = LOWER) : value_(value), type_(type) { }
+};
+
+struct tt_entry_t {
+    uint64_t key;        // state_t::pack()
+    short value;
+    unsigned char type;
+    unsigned char age;   // generation that stored the entry, 0 if empty
+    unsigned size;       // #generated below the entry, saturated
+};
+
+class ttable_t {
+  public:
+    static const int WAYS = 4;
+    struct alignas(64) bucket_t { tt_entry_t e[WAYS]; };
+    static_assert(sizeof(bucket_t) == 64, "a bucket must fill one cache line");
+
+    // where a node was probed, for storing its result later
+    struct slot_t {
+        bucket_t *bucket;
+        uint64_t key;
+    };
+
+    ttable_t() { }
+    ~ttable_t() { close_spill(); release(); }
+    ttable_t(const ttable_t &) = delete;
+    ttable_t& operator=(const ttable_t &) = delete;
+
+    // Sets the size of the RAM table and, if spill_path is not empty, the
+    // file and size of the second level. Nothing is allocated until the
+    // first probe.
+    void configure(size_t memory_bytes, const std::string &spill_path = "", size_t spill_bytes = 0) {
+        close_spill();
+        release();
+        nbuckets_ = std::max<size_t>(1, memory_bytes / sizeof(bucket_t));
+        spill_path_ = spill_path;
+        spill_bytes_ = spill_bytes;
+    }
+
+    // Allocates the table now, on huge pages if possible, and touches
+    // every page, so the searches do not pay for page faults.
+    void reserve() {
+        if ( table_ == nullptr ) allocate(true);
+        else madvise(table_, table_bytes_, MADV_HUGEPAGE);
+        memset(static_cast<void*>(table_), 0, nbuckets_ * sizeof(bucket_t));
+        used_ = 0;
+    }
+
+    // Finds the bucket of state, whose packed form is key, and looks for
+    // state in it. The slot is what store takes once the node is solved.
+    bool probe(const state_t &state, uint64_t key, slot_t &slot, stored_info_t &info) {
+        if ( table_ == nullptr ) allocate(false);
+        slot.key = key;
+        slot.bucket = &table_[index(slot.key, nbuckets_)];
+        bucket_t &b = *slot.bucket;
+        for ( int i = 0; i < WAYS; ++i ) {
+            if ( b.e[i].age == age_ && b.e[i].key == slot.key ) {
+                info = stored_info_t(b.e[i].value, b.e[i].type);
+                return true;
+            }
+        }
+        if ( !probes_spill(state.empties()) ) return false;
+
+        const tt_entry_t *found = nullptr;
+        for ( auto &e : pending_ ) {
+            if ( e.key == slot.key ) found = &e;  // the last one is the newest
+        }
+        bucket_t &s = spill_[index(slot.key, spill_nbuckets_)];
+        for ( int i = 0; i < WAYS && found == nullptr; ++i ) {
+            if ( s.e[i].age == spill_header_->age && s.e[i].key == slot.key ) found = &s.e[i];
+        }
+        if ( found == nullptr ) return false;
+
+        tt_entry_t entry = *found;
+        info = stored_info_t(entry.value, entry.type);
+        entry.age = age_;
+        insert(b, entry);  // promote to RAM
+        ++spill_hits_;
+        return true;
+    }
+
+    void store(const slot_t &slot, const stored_info_t &info, unsigned long long size) {
+        tt_entry_t entry;
+        entry.key = slot.key;
+        entry.value = info.value_;
+        entry.type = info.type_;
+        entry.age = age_;
+        entry.size = size < UINT32_MAX ? size : UINT32_MAX;
+        insert(*slot.bucket, entry);
+    }
+
+    // Starts loading the bucket of a packed state into the cache, without
+    // waiting.
+    void prefetch(uint64_t key) const {
+        if ( table_ != nullptr ) __builtin_prefetch(&table_[index(key, nbuckets_)], 1, 3);
+    }
+
+    // True if positions with that many empty squares may be in the file.
+    bool probes_spill(int empties) const {
+        return spill_ != nullptr && empties >= spill_min_empties;
+    }
+
+    // Starts reading the file page that would hold a packed state, without
+    // waiting.
+    void prefetch_spill(uint64_t key) {
+        if ( spill_ == nullptr ) return;
+        advise(&spill_[index(key, spill_nbuckets_)], sizeof(bucket_t));
+    }
+
+    void clear() {
+        if ( spill_ != nullptr ) flush();
+        used_ = spilled_ = spill_hits_ = 0;
+        if ( ++age_ == 0 ) {
+            // generations wrapped around: really wipe the table
+            if ( table_ != nullptr ) memset(static_cast<void*>(table_), 0, nbuckets_ * sizeof(bucket_t));
+            age_ = 1;
+        }
+        if ( spill_ != nullptr && ++spill_header_->age == 0 ) {
+            memset(static_cast<void*>(spill_), 0, spill_nbuckets_ * sizeof(bucket_t));
+            spill_header_->age = 1;
+        }
+    }
+
+    size_t size() const { return used_; }
+    size_t capacity() const { return nbuckets_ * WAYS; }
+    size_t spilled() const { return spilled_; }
+    size_t spill_hits() const { return spill_hits_; }
+
+    // only entries at least this big are written to the file
+    unsigned long long spill_min_size = 64;
+    // only positions with at least this many empty squares probe (and are
+    // written to) the file
+    int spill_min_empties = 14;
+
+  private:
+    struct spill_header_t {
+        char magic[8];
+        uint64_t nbuckets;
+        unsigned char age;
+    };
+    static const size_t SPILL_OFFSET = 4096; // buckets start after the header page
+    static const size_t SPILL_BATCH = 64;
+    static const size_t HUGE_PAGE = size_t(2) << 20;
+
+    bucket_t *table_ = nullptr;
+    size_t table_bytes_ = 0;     // of the mapping, a multiple of HUGE_PAGE
+    size_t nbuckets_ = (size_t(256) << 20) / sizeof(bucket_t);
+    size_t used_ = 0;
+    unsigned char age_ = 1;
+
+    std::string spill_path_;
+    size_t spill_bytes_ = 0;
+    void *spill_map_ = nullptr;
+    spill_header_t *spill_header_ = nullptr;
+    bucket_t *spill_ = nullptr;
+    size_t spill_nbuckets_ = 0;
+    std::vector<tt_entry_t> pending_;
+    size_t spilled_ = 0, spill_hits_ = 0;
+
+    static size_t index(uint64_t k, size_t nbuckets) {
+        k ^= k >> 33;
+        k *= 0xff51afd7ed558ccdULL;
+        k ^= k >> 33;
+        k *= 0xc4ceb9fe1a85ec53ULL;
+        k ^= k >> 33;
+        return (unsigned __int128)k * nbuckets >> 64;  // k % nbuckets without a division
+    }
+
+    static void advise(const void *p, size_t length) {
+        uintptr_t page = sysconf(_SC_PAGESIZE);
+        uintptr_t start = uintptr_t(p) & ~(page - 1);
+        madvise((void*)start, uintptr_t(p) + length - start, MADV_WILLNEED);
+    }
+
+    // With huge, tries explicit huge pages (reserved in
+    // /proc/sys/vm/nr_hugepages) and falls back to normal pages marked for
+    // transparent huge pages. The mapping is aligned to a huge page either
+    // way, so reserve() can still ask for them later. Anonymous mappings
+    // come zeroed.
+    void allocate(bool huge) {
+        table_bytes_ = (nbuckets_ * sizeof(bucket_t) + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1);
+        void *p = MAP_FAILED;
+        if ( huge ) p = mmap(nullptr, table_bytes_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if ( p == MAP_FAILED ) {
+            p = mmap(nullptr, table_bytes_ + HUGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if ( p == MAP_FAILED ) throw std::bad_alloc();
+            uintptr_t start = uintptr_t(p), aligned = (start + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1);
+            if ( aligned > start ) munmap(p, aligned - start);
+            munmap((void*)(aligned + table_bytes_), start + HUGE_PAGE - aligned);
+            p = (void*)aligned;
+            // without huge, also where transparent huge pages are the default
+            madvise(p, table_bytes_, huge ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+        }
+        table_ = static_cast<bucket_t*>(p);
+        if ( !spill_path_.empty() ) open_spill();
+    }
+
+    void release() {
+        if ( table_ != nullptr ) munmap(table_, table_bytes_);
+        table_ = nullptr;
+    }
+
+    // Puts entry in bucket b, replacing the same position, an empty slot
+    // or, failing that, the entry with the smallest subtree.
+    void insert(bucket_t &b, const tt_entry_t &entry) {
+        tt_entry_t *victim = nullptr;
+        for ( int i = 0; i < WAYS; ++i ) {
+            tt_entry_t &e = b.e[i];
+            if ( e.age != age_ ) {
+                if ( victim == nullptr || victim->age == age_ ) victim = &e;
+            } else if ( e.key == entry.key ) {
+                e = entry;
+                return;
+            } else if ( victim == nullptr || (victim->age == age_ && e.size < victim->size) ) {
+                victim = &e;
+            }
+        }
+        if ( victim->age != age_ ) {
+            ++used_;
+        } else if ( entry.size < victim->size ) {
+            spill(entry);
+            return;
+        } else {
+            spill(*victim);
+        }
+        *victim = entry;
+    }
+
+    void spill(const tt_entry_t &entry) {
+        if ( spill_ == nullptr || entry.size < spill_min_size ) return;
+        if ( state_t::unpack(entry.key).empties() < spill_min_empties ) return;
+        pending_.push_back(entry);
+        if ( pending_.size() >= SPILL_BATCH ) flush();
+    }
+
+    // Writes the buffered evictions, asking for all their pages first so
+    // the reads overlap.
+    void flush() {
+        for ( auto &entry : pending_ )
+            advise(&spill_[index(entry.key, spill_nbuckets_)], sizeof(bucket_t));
+        for ( auto &entry : pending_ ) {
+            bucket_t &s = spill_[index(entry.key, spill_nbuckets_)];
+            tt_entry_t *victim = &s.e[0];
+            for ( int i = 0; i < WAYS; ++i ) {
+                tt_entry_t &e = s.e[i];
+                if ( e.age != spill_header_->age || e.key == entry.key ) {
+                    victim = &e;
+                    break;
+                }
+                if ( e.size < victim->size ) victim = &e;
+            }
+            if ( victim->age == spill_header_->age && !(victim->key == entry.key) && victim->size > entry.size )
+                continue;
+            *victim = entry;
+            victim->age = spill_header_->age;
+            ++spilled_;
+        }
+        pending_.clear();
+    }
+
+    void open_spill() {
+        spill_nbuckets_ = std::max<size_t>(1, spill_bytes_ / sizeof(bucket_t));
+        size_t length = SPILL_OFFSET + spill_nbuckets_ * sizeof(bucket_t);
+        int fd = open(spill_path_.c_str(), O_RDWR | O_CREAT, 0644);
+        if ( fd < 0 || ftruncate(fd, length) != 0 ) {
+            if ( fd >= 0 ) close(fd);
+            throw std::runtime_error("cannot create TT spill file " + spill_path_ + ": " + strerror(errno));
+        }
+        spill_map_ = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if ( spill_map_ == MAP_FAILED ) {
+            spill_map_ = nullptr;
+            throw std::runtime_error("cannot map TT spill file " + spill_path_ + ": " + strerror(errno));
+        }
+        madvise(spill_map_, length, MADV_RANDOM);
+
+        spill_header_ = static_cast<spill_header_t*>(spill_map_);
+        spill_ = reinterpret_cast<bucket_t*>(static_cast<char*>(spill_map_) + SPILL_OFFSET);
+        if ( memcmp(spill_header_->magic, "OTHTT03", 8) != 0 || spill_header_->nbuckets != spill_nbuckets_ ) {
+            // new file, or one made for another size: start from scratch
+            memset(spill_header_, 0, sizeof(spill_header_t));
+            memcpy(spill_header_->magic, "OTHTT03", 8);
+            spill_header_->nbuckets = spill_nbuckets_;
+        }
+        if ( ++spill_header_->age == 0 ) spill_header_->age = 1;
+    }
+
+    void close_spill() {
+        if ( spill_map_ == nullptr ) return;
+        flush();
+        munmap(spill_map_, SPILL_OFFSET + spill_nbuckets_ * sizeof(bucket_t));
+        spill_map_ = nullptr;
+        spill_header_ = nullptr;
+        spill_ = nullptr;
+        pending_.clear();
+    }
+};
+
+#endif
@@ -23,6 +23,7 @@
 #include <iostream>
 #include <sys/resource.h>
 #include <sys/time.h>
+#include <time.h>
 
 //#define DEBUG
 
@@ -35,6 +36,14 @@ inline float read_time_in_seconds() {
            (float)r_usage.ru_utime.tv_usec / (float)1000000;
 }
 
+// CPU time of the calling thread only; what a searcher running in one
+// of several threads should be measured and limited by.
+inline float read_thread_time_in_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (float)ts.tv_sec + (float)ts.tv_nsec / (float)1000000000;
+}
+
 template<typename T> inline T abs(const T a) {
     return a < 0 ? -a : a;
 }